@@ -0,0 +1,109 @@
+#ifndef _BOARD_H_
+#define _BOARD_H_
+
+/* =======================================
+ *          BOARD DESCRIPTION
+ * ======================================= */
+/*
+ * Every pin the firmware drives or reads, in one place. A pin is a
+ * "PORT, BIT" pair; a group of pins sits on one port and lists its bits as
+ * X(name, bit), in the order the module indexes them. The modules expand
+ * the lists with their own X macros into constant masks and tables, so
+ * nothing tests a pin number at run time and moving a pin is an edit here.
+ *
+ *   BOARD_LAT(BOARD_LCD_RS)      -> LATDbits.LATD5
+ *   BOARD_PIN(BOARD_RFID_SO)     -> PORTCbits.RC3
+ *   BOARD_TRIS(BOARD_RFID_SO)    -> TRISCbits.TRISC3
+ *   BOARD_LAT_REG(BOARD_KEYPAD_PORT) -> LATA (also BOARD_PORT_REG, BOARD_TRIS_REG)
+ *   BOARD_PIN_LAT_REG(BOARD_SR_DATA) -> LATD
+ *   BOARD_BIT(BOARD_SR_DATA)         -> (1)
+ *   (0 BOARD_KEYPAD_ROWS(BOARD_MASK))  -> mask of the group
+ *   (0 BOARD_KEYPAD_ROWS(BOARD_COUNT)) -> pins in the group
+ *
+ * Fixed by the silicon and not listed: CCP1 -> RC2 and CCP2 -> RC1
+ * (CCP2MX = RC1, main.c), EUSART TX/RX -> RC6/RC7.
+ */
+
+// Light outputs (TLight.h): LED_BACKEND_PINS or LED_BACKEND_595
+#define LED_BACKEND_PINS 0
+#define LED_BACKEND_595 1
+
+#ifndef LED_BACKEND // Override with -DLED_BACKEND=... in the project options
+#define LED_BACKEND LED_BACKEND_PINS
+#endif
+
+// Interrupt flag LED_Motor serves. On the pins backend it is set every 2ms
+// and is the system tick as well (LED_DRIVES_TICK): Timer0 stays off
+#if LED_BACKEND == LED_BACKEND_595
+#define LED_INTERRUPT_FLAG PIR1bits.CCP1IF
+#define LED_DRIVES_TICK 0
+#else
+#define LED_INTERRUPT_FLAG PIR1bits.TMR2IF
+#define LED_DRIVES_TICK 1
+#endif
+
+// Lights on their own pins (TLight.c LED_BACKEND_PINS): software PWM as
+// X(light, bit); light 3 is the CCP1 output, light 4 the CCP2 one
+#define BOARD_SW_LED_PORT D
+#define BOARD_SW_LEDS(X) X(0, 1) X(1, 2) X(2, 3) X(5, 4)
+#define BOARD_CCP1_LED C, 2
+#define BOARD_CCP2_LED C, 1
+
+// 74HC595 chain (TLight.c LED_BACKEND_595). SER and SRCLK on the same port:
+// each output is shifted with one write of the whole LAT register
+#define BOARD_SR_DATA D, 1  // SER
+#define BOARD_SR_CLOCK D, 2 // SRCLK
+#define BOARD_SR_LATCH D, 3 // RCLK
+
+// 3x4 keypad (TKeypad.c): columns driven high one at a time, rows pulled
+// down. Key (row, column) is row * 3 + column, rows and columns as listed
+#define BOARD_KEYPAD_PORT A
+#define BOARD_KEYPAD_COLUMNS(X) X(COL0, 2) X(COL1, 0) X(COL2, 4)
+#define BOARD_KEYPAD_ROWS(X) X(ROW0, 1) X(ROW1, 6) X(ROW2, 5) X(ROW3, 3)
+
+// HD44780 in 4-bit mode (TLCD.c): D4-D7 on four consecutive bits, D4 first
+#define BOARD_LCD_DATA_PORT B
+#define BOARD_LCD_DATA_SHIFT 0
+#define BOARD_LCD_RS D, 5
+#define BOARD_LCD_RW D, 6
+#define BOARD_LCD_E D, 7
+
+// MFRC522 on the bit-banged SPI (TRFID.c)
+#define BOARD_RFID_SO C, 3  // MISO
+#define BOARD_RFID_SI C, 5  // MOSI
+#define BOARD_RFID_SCK C, 4
+#define BOARD_RFID_CS C, 0  // SDA on the RC522 module
+#define BOARD_RFID_RST D, 0
+
+// Toggled once per main loop pass (main.c)
+#define BOARD_LOOP_MARKER E, 2
+
+/* =======================================
+ *              EXPANSION
+ * ======================================= */
+
+// The outer macros expand "PORT, BIT" pairs before pasting them
+#define BOARD_LAT(pin) BOARD_LAT_(pin)
+#define BOARD_PIN(pin) BOARD_PIN_(pin)
+#define BOARD_TRIS(pin) BOARD_TRIS_(pin)
+#define BOARD_LAT_(port, bit) LAT##port##bits.LAT##port##bit
+#define BOARD_PIN_(port, bit) PORT##port##bits.R##port##bit
+#define BOARD_TRIS_(port, bit) TRIS##port##bits.TRIS##port##bit
+
+#define BOARD_BIT(pin) BOARD_BIT_(pin)
+#define BOARD_PIN_LAT_REG(pin) BOARD_PIN_LAT_REG_(pin)
+#define BOARD_BIT_(port, bit) (bit)
+#define BOARD_PIN_LAT_REG_(port, bit) LAT##port
+
+#define BOARD_LAT_REG(port) BOARD_LAT_REG_(port)
+#define BOARD_PORT_REG(port) BOARD_PORT_REG_(port)
+#define BOARD_TRIS_REG(port) BOARD_TRIS_REG_(port)
+#define BOARD_LAT_REG_(port) LAT##port
+#define BOARD_PORT_REG_(port) PORT##port
+#define BOARD_TRIS_REG_(port) TRIS##port
+
+// X macros for the groups
+#define BOARD_MASK(name, bit) | (1 << (bit))
+#define BOARD_COUNT(name, bit) +1
+
+#endif
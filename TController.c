@@ -8,6 +8,7 @@
 #include "TUserControl.h"
 #include "THora.h"
 #include "TTimer.h"
+#include "TMemory.h"
 
 /* =======================================
  *              CONSTANTS
@@ -31,6 +32,8 @@
 #define SERIAL_SEND_WHO_RESPONSE 8  // On "who in room" - send current user
 #define SERIAL_SEND_CONFIGS 9       // On "show configs" - send all stored configs
 #define SERIAL_WAIT_TIME_INPUT 10   // After time request - wait for time data
+#define SERIAL_WAIT_BAUD_INPUT 11   // After baud request - wait for rate option
+#define SERIAL_SEND_MEMORY 12       // On "memory usage" - send stack and RAM report
 
 /* =======================================
  *         PRIVATE VARIABLES
@@ -47,6 +50,10 @@ static BYTE command_read;
 static BYTE led_num, led_intensity;
 static BYTE user_pos, last_uid_char;
 
+const WORD CNTR_RAM_BYTES = sizeof(state) + sizeof(current_user_position) + sizeof(current_config) + sizeof(time_hour) +
+                           sizeof(time_minute) + sizeof(rfid_uid) + sizeof(command_read) + sizeof(led_num) +
+                           sizeof(led_intensity) + sizeof(user_pos) + sizeof(last_uid_char);
+
 /* =======================================
  *       PRIVATE FUNCTION HEADERS
  * ======================================= */
@@ -185,7 +192,17 @@ void CNTR_Motor(void)
             state = SERIAL_WAIT_TIME_INPUT;
             break;
 
+        case CMD_SET_BAUD:
+            SIO_SendBaudPrompt();
+            state = SERIAL_WAIT_BAUD_INPUT;
+            break;
+
+        case CMD_MEMORY_REPORT:
+            state = SERIAL_SEND_MEMORY;
+            break;
+
         case CMD_ESC:
+        case CMD_BAUD_DETECTED:
             SIO_SendMainMenu();
             finish_comand();
             break;
@@ -228,9 +245,35 @@ void CNTR_Motor(void)
             finish_comand();
         }
         break;
+
+    case SERIAL_SEND_MEMORY:
+        SIO_SendMemoryHeader();
+        SIO_SendMemoryItem((const BYTE *)"Stack max", MEM_GetStackHighWater());
+        SIO_SendMemoryItem((const BYTE *)"Stack size", MEM_STACK_LEVELS);
+        for (BYTE module = 0; module < MEM_GetNumModules(); module++)
+        {
+            SIO_SendMemoryItem(MEM_GetModuleName(module), MEM_GetModuleBytes(module));
+        }
+        SIO_SendMemoryItem((const BYTE *)"RAM - statics", MEM_GetRamAfterStatics());
+        finish_comand();
+        break;
+
+    case SERIAL_WAIT_BAUD_INPUT:
+        if (SIO_ReadBaudRate())
+        {
+            finish_comand();
+        }
+        break;
     }
 }
 
+#ifdef SIM_HOST
+BOOL CNTR_IsIdle(void)
+{
+    return state == INPUT_WAIT_DETECT;
+}
+#endif
+
 /* =======================================
  *        PRIVATE FUNCTION BODIES
  * ======================================= */
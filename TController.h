@@ -36,4 +36,14 @@ void CNTR_Motor(void);
 // - Processes serial commands from PC
 // - Coordinates all subsystem interactions
 
+#ifdef SIM_HOST
+BOOL CNTR_IsIdle(void);
+// Pre: Host simulator build only (sim/Soak.cpp), not built for the PIC
+// Post: Returns TRUE while the controller waits for keypad, RFID or serial input
+// (no command in progress)
+#endif
+
+extern const WORD CNTR_RAM_BYTES;
+// Bytes of static RAM owned by the module, reported by TMemory
+
 #endif
@@ -3,11 +3,16 @@
 #define NUM_LEDS 6
 #define MAX_USERS 42 // 256 bytes EEPROM / 6 bytes per user = 42 users max
 
+// System settings live in the 4 bytes left after the user area (0xFC-0xFF)
+#define BAUD_DIVISOR_ADDRESS (MAX_USERS * NUM_LEDS) // 2 bytes, high byte first
+
 static BYTE write_pos = 0;
 static BYTE read_pos = 0;
 static BYTE base_address;
 static BYTE current_user;
 
+const WORD EEPROM_RAM_BYTES = sizeof(write_pos) + sizeof(read_pos) + sizeof(base_address) + sizeof(current_user);
+
 /* =======================================
  *       PRIVATE FUNCTION HEADERS
  * ======================================= */
@@ -45,6 +50,19 @@ void EEPROM_CleanMemory(void)
     }
 }
 
+WORD EEPROM_ReadBaudDivisor(void)
+{
+    WORD divisor = read_byte(BAUD_DIVISOR_ADDRESS);
+    divisor = (divisor << 8) | read_byte(BAUD_DIVISOR_ADDRESS + 1);
+    return divisor;
+}
+
+void EEPROM_StoreBaudDivisor(WORD divisor)
+{
+    write_byte(BAUD_DIVISOR_ADDRESS, (BYTE)(divisor >> 8));
+    write_byte(BAUD_DIVISOR_ADDRESS + 1, (BYTE)divisor);
+}
+
 BOOL EEPROM_StoreConfigForUser(BYTE user, const BYTE *led_config)
 {
     check_user(user);
@@ -120,9 +138,11 @@ static void write_prepared_info(void)
     EECON1bits.CFGS = 0;  // Access EEPROM
     EECON1bits.WREN = 1;
 
+    di(); // The unlock sequence must not be interrupted
     EECON2 = 0x55;
     EECON2 = 0xAA;
     EECON1bits.WR = 1; // Start write
+    ei(); // The ~4ms write itself runs with the tick (and the LED PWM) alive
 
     while (EECON1bits.WR)
         ;                // Wait for WR to become 0 (end of write operation)
@@ -133,7 +153,5 @@ static void write_prepared_info(void)
 static void write_byte(BYTE address, BYTE data)
 {
     prepare_write_info(address, data);
-    di();
     write_prepared_info();
-    ei();
 }
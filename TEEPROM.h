@@ -5,6 +5,8 @@
 #include <pic18f4321.h>
 #include "Utils.h"
 
+#define EEPROM_NO_BAUD_DIVISOR 0xFFFF // Erased EEPROM, no preferred baud rate stored
+
 void EEPROM_Init(void);
 // Post: Initializes EEPROM memory management and prepares for user configuration storage
 
@@ -16,8 +18,17 @@ BOOL EEPROM_ReadConfigForUser(BYTE user, BYTE *led_config);
 // Pre: user is valid user index, led_config is array of at least 6 bytes
 // Post: Reads user's LED configuration from EEPROM (6 bytes: L0-L5) and returns TRUE when it's done.
 
+WORD EEPROM_ReadBaudDivisor(void);
+// Post: Returns the persisted EUSART baud divisor (SPBRGH:SPBRG), or EEPROM_NO_BAUD_DIVISOR if none was stored
+
+void EEPROM_StoreBaudDivisor(WORD divisor);
+// Post: Persists the preferred EUSART baud divisor. It lives outside the user area, so EEPROM_CleanMemory keeps it
+
 void EEPROM_CleanMemory(void);
 // Post: Clears all stored user configurations and resets to default values
 // All users will have default configuration (all LEDs off: 0,0,0,0,0,0)
 
+extern const WORD EEPROM_RAM_BYTES;
+// Bytes of static RAM owned by the module, reported by TMemory
+
 #endif
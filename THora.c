@@ -2,11 +2,21 @@
 #include "TTimer.h"
 #include "TLCD.h"
 
-#define HOURS 23
+// Time is kept in packed BCD (0x23 = 23): the LCD and the serial port work
+// on its digits, so nothing ever divides by 10
+#define LAST_HOUR 0x23
+#define LAST_MINUTE 0x59
+#define BCD_DIGIT_MASK 0x0F
+#define BCD_CARRY 6 // 0x0A + 6 = 0x10
 
 // Static variables for time keeping
-static BYTE current_hour;    // 0-99 hours
-static BYTE current_minutes; // 0-59 minutes
+static BYTE current_hour;    // 0x00-0x23 hours, BCD
+static BYTE current_minutes; // 0x00-0x59 minutes, BCD
+
+const WORD HORA_RAM_BYTES = sizeof(current_hour) + sizeof(current_minutes);
+
+static BYTE bcd_increment(BYTE value);
+static BOOL is_bcd(BYTE value);
 
 /* =======================================
  *          PUBLIC FUNCTION BODIES
@@ -31,16 +41,16 @@ void HORA_Motor(void)
         TiResetTics(TI_HORA);
 
         // Increment minutes
-        current_minutes++;
+        current_minutes = bcd_increment(current_minutes);
 
         // Handle minute overflow
-        if (current_minutes > 59)
+        if (current_minutes > LAST_MINUTE)
         {
-            current_hour++;
+            current_hour = bcd_increment(current_hour);
             current_minutes = 0;
 
-            // Handle hour overflow (wrap to 0 after 99)
-            if (current_hour > HOURS)
+            // Handle hour overflow (wrap to 00 after 23)
+            if (current_hour > LAST_HOUR)
             {
                 current_hour = 0;
             }
@@ -51,14 +61,14 @@ void HORA_Motor(void)
 
 void HORA_SetTime(BYTE hour, BYTE minutes)
 {
-    // Validate and set hour (0-23)
-    if (hour <= HOURS)
+    // Validate and set hour (0x00-0x23)
+    if (hour <= LAST_HOUR && is_bcd(hour))
     {
         current_hour = hour;
     }
 
-    // Validate and set minutes (0-59)
-    if (minutes <= 59)
+    // Validate and set minutes (0x00-0x59)
+    if (minutes <= LAST_MINUTE && is_bcd(minutes))
     {
         current_minutes = minutes;
     }
@@ -67,3 +77,23 @@ void HORA_SetTime(BYTE hour, BYTE minutes)
     TiResetTics(TI_HORA);
     LCD_UpdateTime(current_hour, current_minutes);
 }
+
+/* =======================================
+ *         PRIVATE FUNCTION BODIES
+ * ======================================= */
+
+static BYTE bcd_increment(BYTE value)
+{
+    // Units past 9 carry into the tens digit
+    value++;
+    if ((value & BCD_DIGIT_MASK) > 9)
+    {
+        value += BCD_CARRY;
+    }
+    return value;
+}
+
+static BOOL is_bcd(BYTE value)
+{
+    return (value & BCD_DIGIT_MASK) <= 9;
+}
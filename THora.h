@@ -10,7 +10,8 @@
  * ======================================= */
 /*
  * TIME MANAGEMENT SYSTEM
- * - Maintains system time in HH:MM format
+ * - Maintains system time in HH:MM format, hours and minutes in packed BCD
+ *   (0x23 = 23) so the LCD and the serial port never divide by 10
  * - Updates automatically based on timer interrupts
  * - Provides time display for LCD interface
  *
@@ -33,8 +34,11 @@ void HORA_Motor(void);
 // Manages 24-hour time format (00:00 - 23:59)
 
 void HORA_SetTime(BYTE hour, BYTE minutes);
-// Pre: hour (0-23), minutes (0-59)
-// Post: Sets system time to specified values
+// Pre: hour (0x00-0x23), minutes (0x00-0x59), packed BCD
+// Post: Sets system time to specified values, an out of range one is ignored
 // Updates internal time counters
 
+extern const WORD HORA_RAM_BYTES;
+// Bytes of static RAM owned by the module, reported by TMemory
+
 #endif
@@ -1,157 +1,153 @@
 #include "TKeypad.h"
 #include "TTimer.h"
+#include "Board.h"
 
-#define WAIT_16MS TWO_MS * 8
 #define WAIT_3S ONE_SECOND * 3
 
 // Special key defines
 #define ZERO_KEY 11
 #define HASH_KEY 12
-#define NO_KEY_PRESSED 13
-
-// Pin assignments (PORTA)
-#define ROW0_PIN_BIT 1 // A1
-#define ROW1_PIN_BIT 6 // A6
-#define ROW2_PIN_BIT 5 // A5
-#define ROW3_PIN_BIT 3 // A3
-
-#define KEYPAD_ROWS 4
-#define KEYPAD_COLS 3
-#define COL0_INDEX 0
-#define COL1_INDEX 1
-#define COL2_INDEX 2
-#define ROW0_INDEX 0
-#define ROW1_INDEX 1
-#define ROW2_INDEX 2
-#define ROW3_INDEX 3
+
+// Pin assignments (PORTA, Board.h)
+// Rows (inputs):  ROW0 -> RA1, ROW1 -> RA6, ROW2 -> RA5, ROW3 -> RA3
+// Cols (outputs): COL0 -> RA2, COL1 -> RA0, COL2 -> RA4
+#define KEYPAD_LAT BOARD_LAT_REG(BOARD_KEYPAD_PORT)
+#define KEYPAD_PORT BOARD_PORT_REG(BOARD_KEYPAD_PORT)
+#define KEYPAD_TRIS BOARD_TRIS_REG(BOARD_KEYPAD_PORT)
+#define COLUMNS_MASK (0 BOARD_KEYPAD_COLUMNS(BOARD_MASK))
+#define KEYPAD_BIT(name, bit) (1 << (bit)),
+
+#define KEYPAD_ROWS (0 BOARD_KEYPAD_ROWS(BOARD_COUNT))
+#define KEYPAD_COLS (0 BOARD_KEYPAD_COLUMNS(BOARD_COUNT))
+#define NUM_KEYS (KEYPAD_ROWS * KEYPAD_COLS)
 
 #define MIN_LED_NUMBER 0
 #define MAX_LED_NUMBER 5
 
-// Simplified state names
-#define IDLE 0
-#define ON_KEY_PRESS 1
-#define READ_KEY_VALUE 2
-#define CHECK_KEY_VALUE 3
-#define STORE_KEY 4
-#define RESET_HOLD 5
-#define ON_KEY_RELEASE 6
-#define WAIT_FOR_RELEASE 7
-
-static BYTE keypad_state;
-static BYTE current_key;
-static BYTE col_index;
-static BYTE command_ready;
-static BYTE led_number;
-static BYTE led_intensity;
+// Debounce: every key keeps its last samples in the low bits of key_history and its
+// debounced state in the top bit. Each column is sampled once every KEYPAD_COLS ticks
+// (6ms), so two equal samples in a row give a 6-12ms debounce
+#define SAMPLES_MASK 0x03
+#define KEY_STABLE_PRESSED 0x80
+
+// Key events (filled by KEY_ScanISR, drained by KEY_Motor)
+#define EVENT_QUEUE_SIZE 8 // Power of 2
+#define EVENT_QUEUE_MASK (EVENT_QUEUE_SIZE - 1)
+#define EVENT_PRESS 0x80    // Set on press, clear on release
+#define EVENT_KEY_MASK 0x0F // Key code 1-12
+
+// Parsed commands (filled by KEY_Motor, drained by the controller)
+// Each entry is COMMAND_RESET or (led << 4) | intensity for an UPDATE_LED
+#define COMMAND_QUEUE_SIZE 4 // Power of 2
+#define COMMAND_QUEUE_MASK (COMMAND_QUEUE_SIZE - 1)
+#define COMMAND_RESET 0x80
+#define COMMAND_LED_SHIFT 4
+#define COMMAND_INTENSITY_MASK 0x0F
+
+static BYTE key_history[NUM_KEYS];
+static BYTE scan_col;
+static BYTE event_queue[EVENT_QUEUE_SIZE];
+static volatile BYTE event_head; // Only written by the ISR
+static BYTE event_tail;          // Only written by KEY_Motor
+static BYTE command_queue[COMMAND_QUEUE_SIZE];
+static BYTE command_head;
+static BYTE command_tail;
+static BYTE led_number; // First key of an UPDATE_LED, waiting for the intensity
 static BOOL waiting_for_second_key;
+static BOOL hash_held;
 static BOOL user_inside;
 
-static void shift_keypad_rows(void);
-static BYTE is_key_pressed(void);
-static BYTE convert_to_key(void);
+// Port bit of each row and column, in key order
+static const BYTE row_bits[KEYPAD_ROWS] = {BOARD_KEYPAD_ROWS(KEYPAD_BIT)};
+static const BYTE column_bits[KEYPAD_COLS] = {BOARD_KEYPAD_COLUMNS(KEYPAD_BIT)};
+
+const WORD KEY_RAM_BYTES = sizeof(key_history) + sizeof(scan_col) + sizeof(event_queue) + sizeof(event_head) +
+                          sizeof(event_tail) + sizeof(command_queue) + sizeof(command_head) + sizeof(command_tail) +
+                          sizeof(led_number) + sizeof(waiting_for_second_key) + sizeof(hash_held) + sizeof(user_inside);
+
+static void debounce_key(BYTE key_index, BOOL pressed);
+static void push_event(BYTE event);
+static void push_command(BYTE command);
+static BOOL is_command_queue_full(void);
+static void process_event(BYTE event);
 static void store_detected_key(BYTE key);
 static BYTE is_valid_led_number(BYTE key);
 static void reset_internal_state(void);
-static void set_column_active(BYTE col_index);
-static void set_all_columns_inactive(void);
-static BOOL is_row_pressed(BYTE row_bit);
-static BYTE get_pressed_row(void);
+static void drive_column(BYTE col_index);
 
 void KEY_Init(void)
 {
-    TRISA = 0xEA;
+    KEYPAD_TRIS = (BYTE)~COLUMNS_MASK; // 0xEA: columns out, rows (and the rest of PORTA) in
     ADCON1 = 0x0F;
-    set_all_columns_inactive();
+
+    for (BYTE i = 0; i < NUM_KEYS; i++)
+    {
+        key_history[i] = 0;
+    }
+    event_head = 0;
+    command_head = 0;
     reset_internal_state();
+
+    // Drive the first column so it has settled by the first tick
+    scan_col = 0;
+    drive_column(scan_col);
 }
 
-void KEY_Motor(void)
+void KEY_ScanISR(void)
 {
-    switch (keypad_state)
+    // The current column was driven one tick ago, so its rows have settled:
+    // one port read samples all of them
+    BYTE rows = KEYPAD_PORT;
+    BYTE key_index = scan_col;
+    for (BYTE row = 0; row < KEYPAD_ROWS; row++)
     {
-    case IDLE:
-        shift_keypad_rows();
-        if (is_key_pressed() && user_inside)
-        {
-            TiResetTics(TI_KEYPAD);
-            keypad_state = ON_KEY_PRESS;
-        }
-        break;
-
-    case ON_KEY_PRESS:
-        if (TiGetTics(TI_KEYPAD) >= WAIT_16MS)
-        {
-            keypad_state = READ_KEY_VALUE;
-        }
-        break;
+        debounce_key(key_index, (rows & row_bits[row]) != 0);
+        key_index += KEYPAD_COLS;
+    }
 
-    case READ_KEY_VALUE:
-        keypad_state = IDLE; // if key not pressed, go to IDLE
-        if (is_key_pressed())
-        {
-            current_key = convert_to_key();
-            keypad_state = CHECK_KEY_VALUE;
-        }
-        break;
+    scan_col++;
+    if (scan_col == KEYPAD_COLS)
+        scan_col = 0;
 
-    case CHECK_KEY_VALUE:
-        TiResetTics(TI_KEYPAD);
-        keypad_state = STORE_KEY; // if key is not #, wait for release
-        if (current_key == HASH_KEY)
-        {
-            waiting_for_second_key = FALSE;
-            keypad_state = RESET_HOLD;
-        }
-        break;
+    drive_column(scan_col);
+}
 
-    case STORE_KEY:
-        store_detected_key(current_key);
-        current_key = NO_KEY_PRESSED;
-        keypad_state = ON_KEY_RELEASE;
-        break;
+void KEY_Motor(void)
+{
+    if (hash_held && TiGetTics(TI_KEYPAD) >= WAIT_3S && !is_command_queue_full()) // # held for 3 seconds, send reset command
+    {
+        push_command(COMMAND_RESET);
+        hash_held = FALSE;
+        waiting_for_second_key = FALSE;
+    }
 
-    case ON_KEY_RELEASE:
-        if (!is_key_pressed())
-        {
-            TiResetTics(TI_KEYPAD);
-            keypad_state = WAIT_FOR_RELEASE;
-        }
-        break;
+    // Keep the events queued until there is room for the command they may produce
+    if (is_command_queue_full() || event_tail == event_head)
+        return;
 
-    case WAIT_FOR_RELEASE:
-        if (TiGetTics(TI_KEYPAD) >= WAIT_16MS)
-        {
-            keypad_state = IDLE;
-        }
-        break;
+    BYTE event = event_queue[event_tail];
+    event_tail = (event_tail + 1) & EVENT_QUEUE_MASK;
 
-    case RESET_HOLD:
-        if (!is_key_pressed()) // if key stops being pressed, reset state
-        {
-            waiting_for_second_key = FALSE;
-            keypad_state = IDLE;
-        }
-        else if (TiGetTics(TI_KEYPAD) >= WAIT_3S) // if key is pressed for 3 seconds, send reset command
-        {
-            command_ready = KEYPAD_RESET;
-            waiting_for_second_key = FALSE;
-            keypad_state = ON_KEY_RELEASE;
-        }
-        break;
-    }
+    if (user_inside)
+        process_event(event);
 }
 
 BYTE KEY_GetCommand(void)
 {
-    return command_ready;
+    if (command_tail == command_head)
+        return KEY_NO_COMMAND;
+    if (command_queue[command_tail] == COMMAND_RESET)
+        return KEYPAD_RESET;
+    return UPDATE_LED;
 }
 
 void KEY_GetUpdateInfo(BYTE *led, BYTE *intensity)
 {
-    *led = led_number;
-    *intensity = led_intensity;
-    command_ready = KEY_NO_COMMAND;
+    BYTE command = command_queue[command_tail];
+    command_tail = (command_tail + 1) & COMMAND_QUEUE_MASK;
+
+    *led = command >> COMMAND_LED_SHIFT;
+    *intensity = command & COMMAND_INTENSITY_MASK;
 }
 
 void KEY_SetUserInside(BOOL inside)
@@ -161,34 +157,80 @@ void KEY_SetUserInside(BOOL inside)
     user_inside = inside;
 }
 
-static void shift_keypad_rows(void)
+/* =======================================
+ *        PRIVATE FUNCTION BODIES
+ * ======================================= */
+
+static void debounce_key(BYTE key_index, BOOL pressed)
 {
-    if (is_key_pressed())
-        return; // If key is pressed, don't shift rows
-    col_index = (col_index + 1) % KEYPAD_COLS;
-    set_all_columns_inactive();
-    set_column_active(col_index);
+    BYTE samples = ((key_history[key_index] << 1) | pressed) & SAMPLES_MASK;
+    BYTE stable = key_history[key_index] & KEY_STABLE_PRESSED;
+
+    if (samples == SAMPLES_MASK && !stable)
+    {
+        stable = KEY_STABLE_PRESSED;
+        push_event(EVENT_PRESS | (key_index + 1));
+    }
+    else if (samples == 0 && stable)
+    {
+        stable = 0;
+        push_event(key_index + 1);
+    }
+
+    key_history[key_index] = stable | samples;
 }
 
-static BYTE is_key_pressed(void)
+static void push_event(BYTE event)
 {
-    return get_pressed_row() != NO_KEY_PRESSED;
+    BYTE next_head = (event_head + 1) & EVENT_QUEUE_MASK;
+    if (next_head == event_tail)
+        return; // Queue full, drop the event
+
+    event_queue[event_head] = event;
+    event_head = next_head;
 }
 
-static BYTE convert_to_key(void)
+static void push_command(BYTE command)
 {
-    BYTE row_index = get_pressed_row();
-    return (row_index * 3) + col_index + 1;
+    command_queue[command_head] = command;
+    command_head = (command_head + 1) & COMMAND_QUEUE_MASK;
+}
+
+static BOOL is_command_queue_full(void)
+{
+    return ((command_head + 1) & COMMAND_QUEUE_MASK) == command_tail;
+}
+
+static void process_event(BYTE event)
+{
+    BYTE key = event & EVENT_KEY_MASK;
+
+    if (event & EVENT_PRESS)
+    {
+        if (key == HASH_KEY)
+        {
+            waiting_for_second_key = FALSE;
+            hash_held = TRUE;
+            TiResetTics(TI_KEYPAD);
+        }
+        else
+        {
+            store_detected_key(key);
+        }
+    }
+    else if (key == HASH_KEY)
+    {
+        hash_held = FALSE; // Released before 3 seconds
+    }
 }
 
 static void store_detected_key(BYTE key)
 {
     if (waiting_for_second_key)
     {
-        led_intensity = key;
         if (key == ZERO_KEY)
-            led_intensity = 0;
-        command_ready = UPDATE_LED;
+            key = 0;
+        push_command((led_number << COMMAND_LED_SHIFT) | key);
         waiting_for_second_key = FALSE;
         return;
     }
@@ -208,65 +250,16 @@ static BYTE is_valid_led_number(BYTE key)
 
 static void reset_internal_state(void)
 {
-    keypad_state = IDLE;
-    current_key = NO_KEY_PRESSED;
-    col_index = 0;
-    command_ready = KEY_NO_COMMAND;
+    event_tail = event_head; // Drop pending events, the ISR only moves the head
+    command_tail = command_head; // Drop commands not yet taken by the controller
     led_number = 0;
-    led_intensity = 0;
     waiting_for_second_key = FALSE;
+    hash_held = FALSE;
     user_inside = FALSE;
 }
 
-static void set_column_active(BYTE col_index)
-{
-    switch (col_index)
-    {
-    case COL0_INDEX:
-        LATAbits.LATA2 = 1;
-        break;
-    case COL1_INDEX:
-        LATAbits.LATA0 = 1;
-        break;
-    case COL2_INDEX:
-        LATAbits.LATA4 = 1;
-        break;
-    }
-}
-
-static void set_all_columns_inactive(void)
-{
-    LATAbits.LATA2 = 0;
-    LATAbits.LATA0 = 0;
-    LATAbits.LATA4 = 0;
-}
-
-static BOOL is_row_pressed(BYTE row_bit)
-{
-    switch (row_bit)
-    {
-    case ROW0_PIN_BIT:
-        return PORTAbits.RA1;
-    case ROW1_PIN_BIT:
-        return PORTAbits.RA6;
-    case ROW2_PIN_BIT:
-        return PORTAbits.RA5;
-    case ROW3_PIN_BIT:
-        return PORTAbits.RA3;
-    default:
-        return FALSE;
-    }
-}
-
-static BYTE get_pressed_row(void)
+static void drive_column(BYTE col_index)
 {
-    if (is_row_pressed(ROW0_PIN_BIT))
-        return ROW0_INDEX;
-    if (is_row_pressed(ROW1_PIN_BIT))
-        return ROW1_INDEX;
-    if (is_row_pressed(ROW2_PIN_BIT))
-        return ROW2_INDEX;
-    if (is_row_pressed(ROW3_PIN_BIT))
-        return ROW3_INDEX;
-    return NO_KEY_PRESSED;
+    // One write: the other columns go low as this one goes high
+    KEYPAD_LAT = (KEYPAD_LAT & (BYTE)~COLUMNS_MASK) | column_bits[col_index];
 }
@@ -13,20 +13,28 @@
 void KEY_Init(void);
 // Post: Initializes keypad hardware and internal state machine
 
+void KEY_ScanISR(void);
+// Pre: Called from the interrupt every tick (2ms), after TiTick
+// Post: Samples one column of the 3x4 matrix, debounces its keys and queues press/release events
+
 void KEY_Motor(void);
-// Post: Processes keypad scanning, debouncing, and command detection
+// Post: Consumes debounced key events and performs command detection
 
 BYTE KEY_GetCommand(void);
-// Post: Returns current command state: NO_COMMAND, UPDATE_LED, or RESET
-// Resets internal command state to NO_COMMAND after returning a command
+// Post: Returns the oldest queued command without removing it: NO_COMMAND, UPDATE_LED, or RESET
+// Commands are queued in typing order (up to 3), so fast sequences like "3 7 4 2" are not lost
 
 void KEY_GetUpdateInfo(BYTE *led, BYTE *intensity);
 // Pre: KEY_GetCommand() returned UPDATE_LED
-// Post: Fills led with LED number (0-5) and intensity with intensity value (0-10, where 10='*')
-// Only valid immediately after KEY_GetCommand() returns UPDATE_LED
+// Post: Removes that command from the queue and fills led with LED number (0-5) and
+// intensity with intensity value (0-10, where 10='*')
 
 void KEY_SetUserInside(BOOL inside);
 // Pre: inside is TRUE if user is inside the room, FALSE otherwise
-// Post: if false, the keypad will not respond to any key press
+// Post: if false, the keypad will not respond to any key press and queued commands are dropped
+// (this is also how a RESET command is removed from the queue)
+
+extern const WORD KEY_RAM_BYTES;
+// Bytes of static RAM owned by the module, reported by TMemory
 
 #endif
@@ -1,36 +1,44 @@
 #include "TLCD.h"
 #include "TTimer.h"
 #include "Utils.h"
+#include "Board.h"
 
 /* =======================================
  *           HARDWARE CONFIGURATION
  * ======================================= */
 
-// New LCD pin assignments:
+// LCD pin assignments (Board.h):
 // Control pins: RS->RD5, RW->RD6, E->RD7
 // Data pins: D4->RB0, D5->RB1, D6->RB2, D7->RB3
-
-// Data pins control macros (RB0-RB3, unchanged)
-#define set_data_pins_output() (TRISBbits.TRISB0 = TRISBbits.TRISB1 = TRISBbits.TRISB2 = TRISBbits.TRISB3 = 0)
-#define set_data_pins_input() (TRISBbits.TRISB0 = TRISBbits.TRISB1 = TRISBbits.TRISB2 = TRISBbits.TRISB3 = 1)
-
-// Control pins configuration (updated to RD5, RD6, RD7)
-#define set_control_pins_output() (TRISDbits.TRISD5 = 0, TRISDbits.TRISD6 = 0, TRISDbits.TRISD7 = 0)
-
-// Individual data bit control (RB0-RB3, unchanged)
-#define set_data_bit_4(state) (LATBbits.LATB0 = (state))
-#define set_data_bit_5(state) (LATBbits.LATB1 = (state))
-#define set_data_bit_6(state) (LATBbits.LATB2 = (state))
-#define set_data_bit_7(state) (LATBbits.LATB3 = (state))
-
-// Control pins (updated to use RD5, RD6, RD7)
-#define get_busy_flag() (PORTBbits.RB3)                 // D7 data line for busy flag
-#define set_register_select_high() (LATDbits.LATD5 = 1) // RS -> RD5
-#define set_register_select_low() (LATDbits.LATD5 = 0)  // RS -> RD5
-#define set_read_write_high() (LATDbits.LATD6 = 1)      // RW -> RD6
-#define set_read_write_low() (LATDbits.LATD6 = 0)       // RW -> RD6
-#define set_enable_high() (LATDbits.LATD7 = 1)          // E -> RD7 (unchanged)
-#define set_enable_low() (LATDbits.LATD7 = 0)           // E -> RD7 (unchanged)
+#define LCD_DATA_LAT BOARD_LAT_REG(BOARD_LCD_DATA_PORT)
+#define LCD_DATA_PORT BOARD_PORT_REG(BOARD_LCD_DATA_PORT)
+#define LCD_DATA_TRIS BOARD_TRIS_REG(BOARD_LCD_DATA_PORT)
+#define LCD_DATA_MASK (0x0F << BOARD_LCD_DATA_SHIFT)
+#define LCD_D7_MASK (0x08 << BOARD_LCD_DATA_SHIFT)
+
+#if BOARD_LCD_DATA_SHIFT > 4
+#error "BOARD_LCD_DATA_SHIFT: D4-D7 must fit in the port"
+#endif
+
+// Data pins control macros
+#define set_data_pins_output() (LCD_DATA_TRIS &= (BYTE)~LCD_DATA_MASK)
+#define set_data_pins_input() (LCD_DATA_TRIS |= LCD_DATA_MASK)
+
+// Control pins configuration
+#define set_control_pins_output() (BOARD_TRIS(BOARD_LCD_RS) = 0, BOARD_TRIS(BOARD_LCD_RW) = 0, BOARD_TRIS(BOARD_LCD_E) = 0)
+
+// D7-D4 = the low nibble of 'nibble', in one write
+#define set_data_nibble(nibble) \
+    (LCD_DATA_LAT = (LCD_DATA_LAT & (BYTE)~LCD_DATA_MASK) | (((nibble) & 0x0F) << BOARD_LCD_DATA_SHIFT))
+
+// Control pins
+#define get_busy_flag() ((LCD_DATA_PORT & LCD_D7_MASK) != 0) // D7 data line for busy flag
+#define set_register_select_high() (BOARD_LAT(BOARD_LCD_RS) = 1)
+#define set_register_select_low() (BOARD_LAT(BOARD_LCD_RS) = 0)
+#define set_read_write_high() (BOARD_LAT(BOARD_LCD_RW) = 1)
+#define set_read_write_low() (BOARD_LAT(BOARD_LCD_RW) = 0)
+#define set_enable_high() (BOARD_LAT(BOARD_LCD_E) = 1)
+#define set_enable_low() (BOARD_LAT(BOARD_LCD_E) = 0)
 
 /* =======================================
  *           LCD COMMAND CONSTANTS
@@ -62,13 +70,19 @@
 #define LCD_5x10_DOTS 0x04
 #define LCD_5x8_DOTS 0x00
 
+// Digits of a packed BCD time field (THora), by nibble
+#define bcd_tens(value) ((value) >> 4)
+#define bcd_units(value) ((value) & 0x0F)
+
 /* =======================================
  *           PRIVATE VARIABLES
  * ======================================= */
 static BYTE current_row;
 static BYTE current_column;
-static BYTE current_hour = 0;   // System hour (0-23)
-static BYTE current_minute = 0; // System minute (0-59)
+static BYTE current_hour = 0;   // System hour (0x00-0x23, BCD)
+static BYTE current_minute = 0; // System minute (0x00-0x59, BCD)
+
+const WORD LCD_RAM_BYTES = sizeof(current_row) + sizeof(current_column) + sizeof(current_hour) + sizeof(current_minute);
 
 /* =======================================
  *        PRIVATE FUNCTION PROTOTYPES
@@ -128,16 +142,16 @@ void LCD_WriteNoUserInfo(void)
     write_character(' ');
 
     // Write current system time
-    write_character((current_hour / 10) + '0');
-    write_character((current_hour % 10) + '0');
+    write_character(bcd_tens(current_hour) + '0');
+    write_character(bcd_units(current_hour) + '0');
     write_character(':');
-    write_character((current_minute / 10) + '0');
-    write_character((current_minute % 10) + '0');
+    write_character(bcd_tens(current_minute) + '0');
+    write_character(bcd_units(current_minute) + '0');
 
     // Write light configuration
-    write_string((const BYTE *)" 0-0 1-0");
+    write_string((const BYTE *)" 1-0 2-0");
     set_cursor_position(1, 0);
-    write_string((const BYTE *)"2-0 3-0 4-0 5-0");
+    write_string((const BYTE *)"3-0 4-0 5-0 6-0");
 }
 
 void LCD_WriteUserInfo(BYTE last_uid_char, const BYTE *light_config)
@@ -162,11 +176,11 @@ void LCD_UpdateTime(BYTE hour, BYTE minute)
     set_cursor_position(0, 2);
 
     // Update time display
-    write_character((hour / 10) + '0');
-    write_character((hour % 10) + '0');
+    write_character(bcd_tens(hour) + '0');
+    write_character(bcd_units(hour) + '0');
     write_character(':');
-    write_character((minute / 10) + '0');
-    write_character((minute % 10) + '0');
+    write_character(bcd_tens(minute) + '0');
+    write_character(bcd_units(minute) + '0');
 }
 
 void LCD_UpdateLightConfig(const BYTE *light_config)
@@ -221,41 +235,7 @@ static void delay_ms(BYTE milliseconds)
 static void send_nibble(BYTE nibble)
 {
     // Set data pins
-    if (nibble & 0x08)
-    {
-        set_data_bit_7(1);
-    }
-    else
-    {
-        set_data_bit_7(0);
-    }
-
-    if (nibble & 0x04)
-    {
-        set_data_bit_6(1);
-    }
-    else
-    {
-        set_data_bit_6(0);
-    }
-
-    if (nibble & 0x02)
-    {
-        set_data_bit_5(1);
-    }
-    else
-    {
-        set_data_bit_5(0);
-    }
-
-    if (nibble & 0x01)
-    {
-        set_data_bit_4(1);
-    }
-    else
-    {
-        set_data_bit_4(0);
-    }
+    set_data_nibble(nibble);
 
     // Pulse enable pin (double call ensures sufficient pulse width)
     set_enable_high();
@@ -273,41 +253,7 @@ static void send_nibble_init(BYTE nibble)
     set_read_write_low();      // Write mode
 
     // Set data pins for 8-bit startup command
-    if (nibble & 0x08)
-    {
-        set_data_bit_7(1);
-    }
-    else
-    {
-        set_data_bit_7(0);
-    }
-
-    if (nibble & 0x04)
-    {
-        set_data_bit_6(1);
-    }
-    else
-    {
-        set_data_bit_6(0);
-    }
-
-    if (nibble & 0x02)
-    {
-        set_data_bit_5(1);
-    }
-    else
-    {
-        set_data_bit_5(0);
-    }
-
-    if (nibble & 0x01)
-    {
-        set_data_bit_4(1);
-    }
-    else
-    {
-        set_data_bit_4(0);
-    }
+    set_data_nibble(nibble);
 
     // Pulse enable pin
     set_enable_high();
@@ -324,41 +270,7 @@ static void send_instruction_init(BYTE instruction)
     set_read_write_low();      // Write mode
 
     // Send upper nibble
-    if (instruction & 0x80)
-    {
-        set_data_bit_7(1);
-    }
-    else
-    {
-        set_data_bit_7(0);
-    }
-
-    if (instruction & 0x40)
-    {
-        set_data_bit_6(1);
-    }
-    else
-    {
-        set_data_bit_6(0);
-    }
-
-    if (instruction & 0x20)
-    {
-        set_data_bit_5(1);
-    }
-    else
-    {
-        set_data_bit_5(0);
-    }
-
-    if (instruction & 0x10)
-    {
-        set_data_bit_4(1);
-    }
-    else
-    {
-        set_data_bit_4(0);
-    }
+    set_data_nibble(instruction >> 4);
 
     set_enable_high();
     set_enable_high();
@@ -366,41 +278,7 @@ static void send_instruction_init(BYTE instruction)
     set_enable_low();
 
     // Send lower nibble
-    if (instruction & 0x08)
-    {
-        set_data_bit_7(1);
-    }
-    else
-    {
-        set_data_bit_7(0);
-    }
-
-    if (instruction & 0x04)
-    {
-        set_data_bit_6(1);
-    }
-    else
-    {
-        set_data_bit_6(0);
-    }
-
-    if (instruction & 0x02)
-    {
-        set_data_bit_5(1);
-    }
-    else
-    {
-        set_data_bit_5(0);
-    }
-
-    if (instruction & 0x01)
-    {
-        set_data_bit_4(1);
-    }
-    else
-    {
-        set_data_bit_4(0);
-    }
+    set_data_nibble(instruction);
 
     set_enable_high();
     set_enable_high();
@@ -463,9 +341,9 @@ static void wait_for_busy(void)
         set_enable_low();
         set_enable_low();
 
-        // Timeout protection (more than 1ms means LCD has gone mad)
+        // Timeout protection (more than 2ms means LCD has gone mad)
         timeout_ticks = TiGetTics(TI_LCD);
-        if (timeout_ticks > 0) // 0 ticks = < 2ms, 1 tick = >= 2ms
+        if (timeout_ticks > 1) // The first tick can come at any time: 2 ticks = >= 2ms
             break;
 
     } while (busy_flag);
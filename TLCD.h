@@ -50,11 +50,14 @@ void LCD_WriteUserInfo(BYTE last_uid_char, const BYTE *light_config);
 // Post: Display shows user char and lights with current system time
 
 void LCD_UpdateTime(BYTE hour, BYTE minute);
-// Pre: hour [0-23], minute [0-59]
+// Pre: hour [0x00-0x23], minute [0x00-0x59], packed BCD (THora)
 // Post: System time updated and displayed, preserves user char and light config
 
 void LCD_UpdateLightConfig(const BYTE *light_config);
 // Pre: light_config[6] with values [0x0-0xA]
 // Post: Light values updated, preserves user char and time
 
+extern const WORD LCD_RAM_BYTES;
+// Bytes of static RAM owned by the module, reported by TMemory
+
 #endif
@@ -1,12 +1,12 @@
 #include "TLight.h"
-#include "TTimer.h"
+#include "Board.h"
 
 /* =======================================
  *              CONSTANTS
  * ======================================= */
 
-// Simple LED pin assignments (much clearer than PORT/TRIS pointers)
-// LED0 -> RD1, LED1 -> RD2, LED2 -> RD3, LED3 -> RC4, LED4 -> RC5, LED5 -> RD4
+// Light indexes. Pins: Board.h (LED0 -> RD1, LED1 -> RD2, LED2 -> RD3,
+// LED3 -> RC2 (CCP1), LED4 -> RC1 (CCP2), LED5 -> RD4)
 #define LED0_INDEX 0
 #define LED1_INDEX 1
 #define LED2_INDEX 2
@@ -17,26 +17,220 @@
 // PWM configuration
 #define MAX_TICS 10 // Maximum tics for PWM cycle (1 tic each 2ms = 50 Hz)
 #define NUM_LEDS 6  // Number of LEDs to control
+#define NUM_SW_LEDS (0 BOARD_SW_LEDS(BOARD_COUNT)) // LEDs driven from LED_Motor, the rest use the CCP modules
+#define NUM_BUFFERS 2 // Light schedule: one LED_Motor runs, one LED_UpdateConfig fills
 
-// LED status
-#define LED_OFF 0
-#define LED_ON 1
+// Crossfade: brightness in 8.8 fixed point, one step per 20ms period over
+// LED_FADE_MS. Steps multiply by the reciprocal of the period count, folded
+// at compile time, instead of dividing at each configuration change
+#define FADE_PERIODS (LED_FADE_MS / 20 > 0 ? LED_FADE_MS / 20 : 1)
+#define FADE_RECIPROCAL ((65536UL + FADE_PERIODS / 2) / FADE_PERIODS)
+
+#if LED_FADE_MS / 20 > 255
+#error "LED_FADE_MS: at most 5100, the periods left of a fade are counted in a BYTE"
+#endif
+
+// Brightness runs in 1/16 of a PWM slot: 0..160 (~7.3 bits). Software LEDs
+// get the fraction of a slot by dithering, see next_period_slots
+#define DITHER_SHIFT 4
+#define DITHER_STEPS (1 << DITHER_SHIFT)
+#define MAX_BRIGHTNESS (MAX_TICS * DITHER_STEPS)
+
+// Dimmest lit level. A software LED below one slot would only light every few
+// periods (level 1 of the CIE curve: one slot in 8, a visible ~6Hz blink), so
+// every nonzero level lights at least one slot per period there. The CCP and
+// BAM outputs resolve any brightness at their own rate
+#if LED_BACKEND == LED_BACKEND_PINS
+#define MIN_LIT_BRIGHTNESS DITHER_STEPS
+#else
+#define MIN_LIT_BRIGHTNESS 1
+#endif
+
+#if LED_BACKEND == LED_BACKEND_PINS
+// Software LEDs share a port: LED_Motor writes all of them at once
+#define SW_LED_LAT BOARD_LAT_REG(BOARD_SW_LED_PORT)
+#define SW_LED_TRIS BOARD_TRIS_REG(BOARD_SW_LED_PORT)
+#define SW_LED_MASK (0 BOARD_SW_LEDS(BOARD_MASK))
+#define SW_LED_INDEX(light, bit) light,
+#define SW_LED_BIT(light, bit) (1 << (bit)),
+
+// TMR2 ON | Prescaler 1:16 | Postscaler 1:4, auto-reload on PR2 match
+// Bit 7: unused
+// Bits 6-3: T2OUTPS = 0011 -> 1:4 postscaler
+// Bit 2: TMR2ON = 1
+// Bits 1-0: T2CKPS = 10 -> 1:16 prescaler
+#define T2CON_CONFIG 0b00011110
+#define PR2_500US 249 // (249 + 1) * 16 / 8 MHz = 500us period, TMR2IF every 4 periods = 2ms
+
+// CCP1/CCP2 in PWM mode on the Timer2 period (2 kHz), single output
+// Bits 7-6: P1M = 00 -> single output (CCP1 only, unused on CCP2)
+// Bits 5-4: DCxB = 00 -> duty LSbs, written by set_hw_duty
+// Bits 3-0: CCPxM = 1100 -> PWM active-high (CCP2)
+//           CCP1M = 1110 -> PWM with P1A active-low (CCP1): LED3 is lit at the
+//           end of the period, LED4 at the start, so they do not turn on together
+#define CCP_PWM_MODE 0b00001100
+#define CCP1_PWM_ACTIVE_LOW 0b00001110
+#define HW_DUTY_PER_4_STEPS 25 // 10-bit duty: 4 * (PR2 + 1) = 1000 counts over MAX_BRIGHTNESS = 160 steps
+#define HW_FULL_DUTY (4 * (PR2_500US + 1))
+
+#elif LED_BACKEND == LED_BACKEND_595
+// 74HC595 chain, bit-banged like the RC522 SPI. /OE tied low, /SRCLR high.
+// Output n of the chain (QA of the first chip = 0) shows light n % NUM_LEDS
+#define SR_CLOCK BOARD_LAT(BOARD_SR_CLOCK) // SRCLK of every chip, shifts on the rising edge
+#define SR_LATCH BOARD_LAT(BOARD_SR_LATCH) // RCLK of every chip, outputs load on the rising edge
+#define SR_LAT BOARD_PIN_LAT_REG(BOARD_SR_DATA) // Port of SER and SRCLK
+#define SR_DATA_MASK (1 << BOARD_BIT(BOARD_SR_DATA)) // SER of the first chip
+#define SR_CLOCK_MASK (1 << BOARD_BIT(BOARD_SR_CLOCK))
+#define SR_BYTES (LED_595_CHANNELS / 8)
+#define SR_PATTERN_BYTES 3 // Outputs repeat the lights every lcm(8, NUM_LEDS) = 24
+
+#if LED_595_CHANNELS % 8 != 0 || LED_595_CHANNELS < 8 || LED_595_CHANNELS > 64
+#error "LED_595_CHANNELS: 8 to 64, a multiple of 8"
+#endif
+
+// Bit-angle modulation: BAM_BITS planes per 20ms period, bit k shown for
+// 2^k / 255 of it (rounded, the lengths add up to the period). One interrupt
+// per bit, whatever the number of outputs
+#define BAM_BITS 8
+#define BAM_PERIOD_US 20000UL
+#define BAM_TICKS(bit) (((BAM_PERIOD_US << (bit)) + 127) / 255)
+#define BAM_CODE_MUL 51 // Brightness 0..MAX_BRIGHTNESS to a code 0..255: * 255 / 160 = * 51 / 32, rounded
+#define BAM_CODE_SHIFT 5
+#define BAM_CODE_ROUND (1 << (BAM_CODE_SHIFT - 1))
+
+// The next plane shifts in during the bit on show, so it has to fit in bit 0.
+// Instruction cycles (8 per us), counted on the PIC18 instructions each step
+// takes: SR_SHIFT_BIT is 5 (movf, btfsc, movf, movwf, bsf), a byte adds the
+// indexed load and the loop; the interrupt entry, dispatch, latch, CCPR1
+// reload and exit take SR_ISR_CYCLES
+#define SR_CYCLES_PER_BYTE (8 * 5 + 12)
+#define SR_ISR_CYCLES 120
+#if SR_ISR_CYCLES + SR_BYTES * SR_CYCLES_PER_BYTE > BAM_TICKS(0) * 8
+#error "LED_595_CHANNELS: the next plane does not shift in within BAM bit 0"
+#endif
+
+// One output, last chip first: SER with SRCLK low in one write of the port,
+// then the SRCLK rising edge
+#define SR_SHIFT_BIT(data, mask, ser_high, ser_low) \
+    SR_LAT = ((data) & (mask)) ? (ser_high) : (ser_low); \
+    SR_CLOCK = 1
+
+// Timer1 in 16-bit mode, 1us per count
+// Bit 7: RD16 = 1 -> 16-bit reads/writes
+// Bits 5-4: T1CKPS = 11 -> 1:8 prescaler
+// Bit 1: TMR1CS = 0 -> Fosc/4
+// Bit 0: TMR1ON = 1
+#define T1CON_CONFIG 0b10110001
+
+// CCP1 compare with special event trigger: on TMR1 = CCPR1 it sets CCP1IF
+// and resets Timer1, so CCPR1 is the length of the running bit
+// Bits 3-0: CCP1M = 1011
+#define CCP_COMPARE_RESET 0b00001011
+
+#else
+#error "LED_BACKEND: unknown backend"
+#endif
+
+// Brightness of 'level' on the LED_CURVE curve, rounded. Integer constant
+// expressions only: the compiler folds them into LED_LEVEL_BRIGHTNESS
+#if LED_CURVE == LED_CURVE_LINEAR
+#define CURVE(level) ((level) * DITHER_STEPS)
+#elif LED_CURVE == LED_CURVE_GAMMA2
+#define CURVE(level) (((level) * (level) * MAX_BRIGHTNESS + MAX_TICS * MAX_TICS / 2) / (MAX_TICS * MAX_TICS))
+#elif LED_CURVE == LED_CURVE_CIE1931
+// Y = ((L* + 16) / 116)^3 for L* = 100 * level / MAX_TICS above 8, Y = L* / 903.3 below (level 0 only)
+#define CIE_LSTAR(level) (100 * (level) / MAX_TICS + 16)
+#define CIE_CUBE(level) ((unsigned long)CIE_LSTAR(level) * CIE_LSTAR(level) * CIE_LSTAR(level))
+#define CURVE(level) ((level) == 0 ? 0 : (CIE_CUBE(level) * MAX_BRIGHTNESS + 116UL * 116 * 116 / 2) / (116UL * 116 * 116))
+#else
+#error "LED_CURVE: unknown curve"
+#endif
+#define LEVEL_BRIGHTNESS(level) ((level) != 0 && CURVE(level) < MIN_LIT_BRIGHTNESS ? MIN_LIT_BRIGHTNESS : CURVE(level))
 
 /* =======================================
  *        PRIVATE FUNCTION HEADERS
  * ======================================= */
 
 // Helper functions - much easier to understand (Java-style)
+static BYTE level_to_brightness(BYTE level);
+static BYTE fade_brightness(BYTE led_index);
+static WORD fade_step_between(BYTE from, BYTE to);
+static BOOL next_period(void);
+#if LED_BACKEND == LED_BACKEND_PINS
 static void configure_all_leds_as_outputs(void);
-static void set_led(BYTE led_index, BYTE state);
-static void update_led_pwm(BYTE led_index, BYTE brightness, WORD current_tics);
+static BYTE led_pwm_mask(BYTE sw_index, BYTE current_tics);
+static BYTE next_period_slots(BYTE sw_index);
+static void set_hw_duty(BYTE led_index, BYTE brightness);
+static void stagger_phases(BYTE buffer, const BYTE *from);
+#else
+static void build_planes(void);
+static void shift_plane(BYTE bit);
+#endif
 
 /* =======================================
  *         PRIVATE VARIABLES
  * ======================================= */
 
-// LED configuration array (intensity level 0-10 for each LED)
-static BYTE led_config[NUM_LEDS];
+// Light schedule, double-buffered. LED_UpdateConfig fills the buffer LED_Motor
+// is not reading and sets swap_pending; LED_Motor flips active_buffer at the
+// next period boundary, so a new configuration never mixes with the old one.
+// Each LED: target brightness (0..MAX_BRIGHTNESS) and the 8.8 step that
+// fades to it in FADE_PERIODS (two's complement when dimming). Software LEDs:
+// phase (slots of the period before the pulse). Shared with the ISR, volatile
+// so every store of the handshake happens, in program order
+static volatile BYTE led_target[NUM_BUFFERS][NUM_LEDS];
+static volatile WORD fade_step[NUM_BUFFERS][NUM_LEDS];
+#if LED_BACKEND == LED_BACKEND_PINS
+static volatile BYTE sw_phase[NUM_BUFFERS][NUM_SW_LEDS];
+#endif
+static volatile BYTE active_buffer; // Only written by the ISR
+static volatile BYTE swap_pending;
+
+// Brightness of each LED in 8.8 fixed point (the high byte is the one lit)
+// and the periods left of the running fade. Only written by the ISR
+static volatile WORD fade_level[NUM_LEDS];
+static volatile BYTE fade_periods_left;
+
+#if LED_BACKEND == LED_BACKEND_PINS
+// Tic of the running period, 1..MAX_TICS
+static BYTE period_tic;
+
+// Software LEDs: slots lit in the running period and the fraction of a slot
+// (in DITHER_STEPS) owed to the next periods
+static BYTE led_slots[NUM_SW_LEDS];
+static BYTE dither_error[NUM_SW_LEDS];
+
+// LEDs the Timer2 interrupt drives and their pins, LED3 and LED4 run on CCP1/CCP2
+static const BYTE sw_leds[NUM_SW_LEDS] = {BOARD_SW_LEDS(SW_LED_INDEX)};
+static const BYTE sw_led_bits[NUM_SW_LEDS] = {BOARD_SW_LEDS(SW_LED_BIT)};
+#else
+// Bit k of every chain output, one plane per BAM bit (byte 0 = outputs 0-7),
+// and the bit on the outputs
+static BYTE bam_planes[BAM_BITS][SR_BYTES];
+static BYTE bam_bit;
+
+// Length of each bit in Timer1 counts (us)
+static const WORD bam_ticks[BAM_BITS] = {
+    BAM_TICKS(0), BAM_TICKS(1), BAM_TICKS(2), BAM_TICKS(3),
+    BAM_TICKS(4), BAM_TICKS(5), BAM_TICKS(6), BAM_TICKS(7)};
+#endif
+
+// One entry per level 0..MAX_TICS
+const BYTE LED_LEVEL_BRIGHTNESS[MAX_TICS + 1] = {
+    LEVEL_BRIGHTNESS(0), LEVEL_BRIGHTNESS(1), LEVEL_BRIGHTNESS(2), LEVEL_BRIGHTNESS(3),
+    LEVEL_BRIGHTNESS(4), LEVEL_BRIGHTNESS(5), LEVEL_BRIGHTNESS(6), LEVEL_BRIGHTNESS(7),
+    LEVEL_BRIGHTNESS(8), LEVEL_BRIGHTNESS(9), LEVEL_BRIGHTNESS(10)};
+
+const BYTE LED_FADE_PERIODS = FADE_PERIODS;
+
+#if LED_BACKEND == LED_BACKEND_PINS
+const WORD LED_RAM_BYTES = sizeof(led_target) + sizeof(fade_step) + sizeof(sw_phase) + sizeof(active_buffer) +
+                          sizeof(swap_pending) + sizeof(fade_level) + sizeof(fade_periods_left) + sizeof(led_slots) +
+                          sizeof(dither_error) + sizeof(period_tic);
+#else
+const WORD LED_RAM_BYTES = sizeof(led_target) + sizeof(fade_step) + sizeof(active_buffer) + sizeof(swap_pending) +
+                          sizeof(fade_level) + sizeof(fade_periods_left) + sizeof(bam_planes) + sizeof(bam_bit);
+#endif
 
 /* =======================================
  *         PUBLIC FUNCTION BODIES
@@ -44,103 +238,367 @@ static BYTE led_config[NUM_LEDS];
 
 void LED_Init(void)
 {
+    // Initialize all LEDs to OFF (clean and simple)
+    active_buffer = 0;
+    swap_pending = 0;
+    fade_periods_left = 0;
+    for (BYTE i = 0; i < NUM_LEDS; i++)
+    {
+        led_target[0][i] = 0;
+        fade_step[0][i] = 0;
+        fade_level[i] = 0;
+    }
+
+#if LED_BACKEND == LED_BACKEND_PINS
     // Configure all LED pins as outputs (much simpler!)
     configure_all_leds_as_outputs();
 
-    // Initialize all LEDs to OFF (clean and simple)
-    for (BYTE i = 0; i < NUM_LEDS; i++)
+    for (BYTE i = 0; i < NUM_SW_LEDS; i++)
     {
-        set_led(i, LED_OFF);
-        led_config[i] = 0;
+        sw_phase[0][i] = 0;
+        led_slots[i] = 0;
+        dither_error[i] = 0;
     }
+    SW_LED_LAT &= (BYTE)~SW_LED_MASK;
+    CCP1CON = CCP1_PWM_ACTIVE_LOW;
+    CCP2CON = CCP_PWM_MODE;
+    set_hw_duty(LED3_INDEX, 0);
+    set_hw_duty(LED4_INDEX, 0);
+
+    // PWM tics come from Timer2, reloaded by hardware: the period does not
+    // depend on the interrupt latency. The same interrupt ticks TTimer
+    T2CON = T2CON_CONFIG;
+    PR2 = PR2_500US;
+    TMR2 = 0;
+    PIR1bits.TMR2IF = 0;
+    PIE1bits.TMR2IE = 1;
+    INTCONbits.PEIE = 1;
+#else
+    // Chain pins as outputs, every output off from the start
+    BOARD_TRIS(BOARD_SR_DATA) = 0;
+    BOARD_TRIS(BOARD_SR_CLOCK) = 0;
+    BOARD_TRIS(BOARD_SR_LATCH) = 0;
+    SR_CLOCK = 0;
+    SR_LATCH = 0;
+    bam_bit = 0;
+    build_planes();
+    shift_plane(0);
+    SR_LATCH = 1;
+    SR_LATCH = 0;
+
+    // Bit lengths come from Timer1, reset by hardware on the CCP1 match: the
+    // period does not depend on the interrupt latency. Timer2 and the CCP
+    // PWM are not used
+    T1CON = T1CON_CONFIG;
+    TMR1H = 0; // RD16: buffered, loaded with the TMR1L write
+    TMR1L = 0;
+    CCPR1H = (BYTE)(bam_ticks[0] >> 8);
+    CCPR1L = (BYTE)bam_ticks[0];
+    CCP1CON = CCP_COMPARE_RESET;
+    PIR1bits.CCP1IF = 0;
+    PIE1bits.CCP1IE = 1;
+    INTCONbits.PEIE = 1;
+#endif
 }
 
+#if LED_BACKEND == LED_BACKEND_PINS
 void LED_Motor(void)
 {
-    static WORD current_tics;
+    PIR1bits.TMR2IF = 0;
 
-    // Get current timer tics using TI_LIGHTS timer handle
-    current_tics = TiGetTics(TI_LIGHTS);
+    // Tics run 1..MAX_TICS, one per Timer2 interrupt (20ms = 50Hz PWM)
+    period_tic++;
+    if (period_tic > MAX_TICS)
+    {
+        period_tic = 1;
+    }
 
-    // Update each LED using PWM (much cleaner with loop!)
-    for (BYTE i = 0; i < NUM_LEDS; i++)
+    if (period_tic == 1)
     {
-        update_led_pwm(i, led_config[i], current_tics);
+        // The CCPs latch their duty at the next Timer2 period, 500us away
+        if (next_period())
+        {
+            set_hw_duty(LED3_INDEX, fade_brightness(LED3_INDEX));
+            set_hw_duty(LED4_INDEX, fade_brightness(LED4_INDEX));
+        }
+
+        for (BYTE i = 0; i < NUM_SW_LEDS; i++)
+        {
+            led_slots[i] = next_period_slots(i);
+        }
     }
 
-    // Reset timer every MAX_TICS for perfect 50Hz PWM
-    if (current_tics >= MAX_TICS)
+    // Every software LED in one write: no per-pin branches, and edges of the
+    // same tic land together
+    BYTE lit = 0;
+    for (BYTE i = 0; i < NUM_SW_LEDS; i++)
     {
-        TiResetTics(TI_LIGHTS);
+        lit |= led_pwm_mask(i, period_tic);
     }
+    SW_LED_LAT = (SW_LED_LAT & (BYTE)~SW_LED_MASK) | lit;
 }
+#else
+void LED_Motor(void)
+{
+    PIR1bits.CCP1IF = 0;
+
+    // Timer1 has just been reset: show the plane shifted in during the last
+    // bit, for as long as its weight. Latching first keeps the outputs on the
+    // hardware edges (plus a constant latency)
+    SR_LATCH = 1;
+    SR_LATCH = 0;
+    CCPR1H = (BYTE)(bam_ticks[bam_bit] >> 8); // TMR1 restarted a few us ago, below any half-written value (>= 55)
+    CCPR1L = (BYTE)bam_ticks[bam_bit];
+
+    bam_bit++;
+    if (bam_bit == BAM_BITS)
+    {
+        // The longest bit is on: the next period starts at the next match.
+        // Its planes are only rebuilt when a swap or a fade moved the lights
+        bam_bit = 0;
+        if (next_period())
+        {
+            build_planes();
+        }
+    }
+    shift_plane(bam_bit);
+}
+#endif
 
 void LED_UpdateConfig(BYTE *config)
 {
+    BYTE from[NUM_LEDS];
+    BYTE buffer;
     BYTE i;
 
-    // Copy new configuration to private array
+    // LED_Motor only flips to the spare buffer once swap_pending is set: clear
+    // it first so a schedule still pending is not taken half rewritten
+    swap_pending = 0;
+    buffer = active_buffer ^ 1;
+
+    // Fill the spare buffer with the new configuration, fading from where
+    // each LED is now (a fade still running may take one more step before
+    // the swap: the last period lands on the target anyway)
     for (i = 0; i < NUM_LEDS; i++)
     {
-        // Ensure values are within valid range (0-10)
-        if (config[i] > MAX_TICS)
-            led_config[i] = MAX_TICS;
-        else
-            led_config[i] = config[i];
+        from[i] = fade_brightness(i);
+        led_target[buffer][i] = level_to_brightness(config[i]);
+        fade_step[buffer][i] = fade_step_between(from[i], led_target[buffer][i]);
     }
+#if LED_BACKEND == LED_BACKEND_PINS
+    stagger_phases(buffer, from);
+#endif
+
+    // All LEDs take it at the start of the next PWM period (LED_Motor)
+    swap_pending = 1;
 }
 
 /* =======================================
  *        PRIVATE FUNCTION BODIES
  * ======================================= */
 
-static void update_led_pwm(BYTE led_index, BYTE brightness, WORD current_tics)
+#if LED_BACKEND == LED_BACKEND_PINS
+static BYTE led_pwm_mask(BYTE sw_index, BYTE current_tics)
 {
-    // Simple PWM logic: LED ON when current_tics < brightness
-    BYTE led_state;
-    if (current_tics < brightness)
+    // Simple PWM logic: tics run 1..MAX_TICS, LED ON for its slots of them after the first 'phase'
+    BYTE phase = sw_phase[active_buffer][sw_index];
+    if (current_tics > phase && current_tics <= phase + led_slots[sw_index])
     {
-        led_state = LED_ON;
+        return sw_led_bits[sw_index];
+    }
+    return 0;
+}
+
+static void configure_all_leds_as_outputs(void)
+{
+    SW_LED_TRIS &= (BYTE)~SW_LED_MASK;
+    BOARD_TRIS(BOARD_CCP1_LED) = 0; // LED3 (CCP1) output
+    BOARD_TRIS(BOARD_CCP2_LED) = 0; // LED4 (CCP2) output
+}
+
+static BYTE next_period_slots(BYTE sw_index)
+{
+    // First-order sigma-delta: whole slots are lit now, the remainder carries
+    // over, so consecutive periods alternate between the two nearest slot
+    // counts and average out to the brightness
+    BYTE total = dither_error[sw_index] + fade_brightness(sw_leds[sw_index]);
+    dither_error[sw_index] = total & (DITHER_STEPS - 1);
+    return total >> DITHER_SHIFT;
+}
+#endif
+
+static BYTE level_to_brightness(BYTE level)
+{
+    // Table lookup only, the curve was evaluated at compile time. Ensure
+    // values are within valid range (0-10)
+    if (level > MAX_TICS)
+    {
+        level = MAX_TICS;
+    }
+    return LED_LEVEL_BRIGHTNESS[level];
+}
+
+static BYTE fade_brightness(BYTE led_index)
+{
+    // High byte only: a single read, safe from the main loop
+    return (BYTE)(fade_level[led_index] >> 8);
+}
+
+static WORD fade_step_between(BYTE from, BYTE to)
+{
+    // (to - from) * 256 / FADE_PERIODS in 8.8, negated when dimming
+    if (to >= from)
+    {
+        return (WORD)(((unsigned long)(to - from) * FADE_RECIPROCAL) >> 8);
+    }
+    return (WORD)0 - (WORD)(((unsigned long)(from - to) * FADE_RECIPROCAL) >> 8);
+}
+
+static BOOL next_period(void)
+{
+    // Period boundary: a new schedule takes over here, all of it at once, and
+    // starts fading in. One add per LED and period while fading; the last
+    // period lands on the target exactly. TRUE when the brightness moved
+    if (swap_pending)
+    {
+        active_buffer ^= 1;
+        swap_pending = 0;
+        fade_periods_left = FADE_PERIODS;
+    }
+    if (fade_periods_left == 0)
+    {
+        return FALSE;
+    }
+    fade_periods_left--;
+    for (BYTE i = 0; i < NUM_LEDS; i++)
+    {
+        if (fade_periods_left == 0)
+        {
+            fade_level[i] = (WORD)led_target[active_buffer][i] << 8;
+        }
+        else
+        {
+            fade_level[i] += fade_step[active_buffer][i];
+        }
+    }
+    return TRUE;
+}
+
+#if LED_BACKEND == LED_BACKEND_PINS
+static void set_hw_duty(BYTE led_index, BYTE brightness)
+{
+    // 10-bit duty in Tosc * prescaler units: 8 MSbs in CCPRxL, 2 LSbs in DCxB.
+    // A duty of 4 * (PR2 + 1) or more keeps the output active. The CCP
+    // resolves the brightness directly, no dithering. Called right after a
+    // period boundary: both parts land before the CCP latches them
+    WORD duty = ((WORD)brightness * HW_DUTY_PER_4_STEPS) >> 2;
+    if (led_index == LED3_INDEX)
+    {
+        // Active-low output: the duty sets the dark part of the period
+        duty = HW_FULL_DUTY - duty;
+        CCPR1L = (BYTE)(duty >> 2);
+        CCP1CONbits.DC1B = duty & 0x03;
     }
     else
     {
-        led_state = LED_OFF;
+        CCPR2L = (BYTE)(duty >> 2);
+        CCP2CONbits.DC2B = duty & 0x03;
     }
-    set_led(led_index, led_state);
 }
 
-static void configure_all_leds_as_outputs(void)
+static void stagger_phases(BYTE buffer, const BYTE *from)
 {
-    // Configure each LED pin as output (much clearer than bit operations!)
-    TRISDbits.TRISD1 = 0; // LED0 -> RD1 output
-    TRISDbits.TRISD2 = 0; // LED1 -> RD2 output
-    TRISDbits.TRISD3 = 0; // LED2 -> RD3 output
-    TRISCbits.TRISC4 = 0; // LED3 -> RC4 output
-    TRISCbits.TRISC5 = 0; // LED4 -> RC5 output
-    TRISDbits.TRISD4 = 0; // LED5 -> RD4 output
+    // Lays the software LED pulses one after another along the period: each
+    // one turns on where the previous one turns off, so their edges spread
+    // out. Same duty, only the start of the pulse moves. A pulse never
+    // crosses the period boundary, where the schedule swaps: one that does
+    // not fit is moved back to end on it and the next starts over at slot 0.
+    // Slots are the most the fade lights (its brighter end, rounded up)
+    BYTE start = 0;
+    for (BYTE i = 0; i < NUM_SW_LEDS; i++)
+    {
+        BYTE brightest = led_target[buffer][sw_leds[i]];
+        if (from[sw_leds[i]] > brightest)
+        {
+            brightest = from[sw_leds[i]];
+        }
+        BYTE slots = (brightest + DITHER_STEPS - 1) >> DITHER_SHIFT;
+        if (start + slots > MAX_TICS)
+        {
+            start = MAX_TICS - slots;
+        }
+        sw_phase[buffer][i] = start;
+        start += slots;
+        if (start >= MAX_TICS)
+        {
+            start = 0;
+        }
+    }
+}
+#else
+static void build_planes(void)
+{
+    // Transposes the lights into one plane per BAM bit. The first
+    // SR_PATTERN_BYTES hold every output pattern, the rest of the chain
+    // repeats them
+    BYTE code[NUM_LEDS];
+    BYTE light = 0;
+    for (BYTE i = 0; i < NUM_LEDS; i++)
+    {
+        code[i] = (BYTE)(((WORD)fade_brightness(i) * BAM_CODE_MUL + BAM_CODE_ROUND) >> BAM_CODE_SHIFT);
+    }
+    for (BYTE byte = 0; byte < SR_BYTES; byte++)
+    {
+        for (BYTE bit = 0; bit < BAM_BITS; bit++)
+        {
+            bam_planes[bit][byte] = byte < SR_PATTERN_BYTES ? 0 : bam_planes[bit][byte - SR_PATTERN_BYTES];
+        }
+        if (byte >= SR_PATTERN_BYTES)
+        {
+            continue;
+        }
+        for (BYTE mask = 0x01; mask; mask <<= 1)
+        {
+            BYTE value = code[light];
+            for (BYTE bit = 0; bit < BAM_BITS; bit++)
+            {
+                if (value & 0x01)
+                {
+                    bam_planes[bit][byte] |= mask;
+                }
+                value >>= 1;
+            }
+            light++;
+            if (light == NUM_LEDS)
+            {
+                light = 0;
+            }
+        }
+    }
 }
 
-static void set_led(BYTE led_index, BYTE state)
+static void shift_plane(BYTE bit)
 {
-    switch (led_index)
-    {
-    case LED0_INDEX:
-        LATDbits.LATD1 = state; // LED0 -> RD1
-        break;
-    case LED1_INDEX:
-        LATDbits.LATD2 = state; // LED1 -> RD2
-        break;
-    case LED2_INDEX:
-        LATDbits.LATD3 = state; // LED2 -> RD3
-        break;
-    case LED3_INDEX:
-        LATCbits.LATC4 = state; // LED3 -> RC4
-        break;
-    case LED4_INDEX:
-        LATCbits.LATC5 = state; // LED4 -> RC5
-        break;
-    case LED5_INDEX:
-        LATDbits.LATD4 = state; // LED5 -> RD4
-        break;
+    // Last output first: after LED_595_CHANNELS clocks it sits on the last
+    // chip's QH and output 0 on the first chip's QA. Unrolled per byte to
+    // stay within bit 0 (SR_CYCLES_PER_BYTE). The port is written whole, so
+    // only from LED_Motor or before its interrupt is on
+    const BYTE *plane = bam_planes[bit];
+    BYTE ser_low = SR_LAT & (BYTE)~(SR_DATA_MASK | SR_CLOCK_MASK);
+    BYTE ser_high = ser_low | SR_DATA_MASK;
+    BYTE byte = SR_BYTES;
+    while (byte--)
+    {
+        BYTE data = plane[byte];
+        SR_SHIFT_BIT(data, 0x80, ser_high, ser_low);
+        SR_SHIFT_BIT(data, 0x40, ser_high, ser_low);
+        SR_SHIFT_BIT(data, 0x20, ser_high, ser_low);
+        SR_SHIFT_BIT(data, 0x10, ser_high, ser_low);
+        SR_SHIFT_BIT(data, 0x08, ser_high, ser_low);
+        SR_SHIFT_BIT(data, 0x04, ser_high, ser_low);
+        SR_SHIFT_BIT(data, 0x02, ser_high, ser_low);
+        SR_SHIFT_BIT(data, 0x01, ser_high, ser_low);
     }
+    SR_CLOCK = 0;
 }
+#endif
@@ -2,6 +2,7 @@
 #define TLIGHT_H
 
 #include "Utils.h"
+#include "Board.h"
 #include <xc.h>
 #include <pic18f4321.h>
 
@@ -10,36 +11,115 @@
  * ======================================= */
 /*
  * HARDWARE CONFIGURATION:
- * - 6 LEDs controlled via PWM at 50Hz
+ * - 6 LEDs controlled via PWM: 50Hz in software, 2kHz on the CCPs
  * - Pin assignments:
  *   * LED0 -> RD1
  *   * LED1 -> RD2
  *   * LED2 -> RD3
- *   * LED3 -> RC4
- *   * LED4 -> RC5
+ *   * LED3 -> RC2 (CCP1 hardware PWM)
+ *   * LED4 -> RC1 (CCP2 hardware PWM, CCP2MX = RC1)
  *   * LED5 -> RD4
  *
  * INTENSITY LEVELS:
  * - 0: LED OFF (0% brightness)
- * - 1-9: Variable brightness (10%-90%)
+ * - 1-9: Variable brightness along LED_CURVE (10%-90% on the default
+ *   linear curve; lower on the others, never below one 2ms slot per period
+ *   on the software PWM pins, so levels 1-3 of LED_CURVE_CIE1931 match there)
  * - 10: LED fully ON (100% brightness)
+ * - Internally each level maps to a brightness in 1/16 of a PWM slot (0-160)
+ *   through a flash table built at compile time on the LED_CURVE curve.
+ *   Software LEDs get the fraction of a slot by temporal dithering: each
+ *   period lights the nearest lower or upper slot count, carrying the error
+ *   to the next periods (first-order sigma-delta), at no extra interrupts
  *
- * DEPENDENCIES:
- * - TTimer module (uses TI_LIGHTS timer)
+ * TIMING:
+ * - Timer2 (owned by this module) interrupts every 2ms, auto-reloaded on the
+ *   PR2 match: one PWM tic per interrupt, 10 tics per 50Hz period
+ * - LED3 and LED4 run on the CCP1/CCP2 PWM modules, clocked by the same
+ *   Timer2 period (500us, 2kHz) with a 10-bit duty: no interrupt work and no
+ *   flicker. The hardware cannot go down to 50Hz at 32MHz (~1.95kHz minimum)
+ * - Turn-on edges are staggered: each software LED's pulse starts where the
+ *   previous one's ends, never crossing the period boundary (phases
+ *   recomputed by LED_UpdateConfig),
+ *   and CCP1 runs active-low so LED3 is lit at the end of the Timer2 period
+ *   while LED4 is lit at the start. The duty is unchanged
+ * - A new configuration crossfades in over LED_FADE_MS: fixed-point steps
+ *   computed once by LED_UpdateConfig, one add per LED and 20ms period
+ * - The Timer2 interrupt is also the system 2ms tick (TiTick and the keypad
+ *   scan run from it), so Timer0 is left off: one interrupt source, 500 per
+ *   second. The 595 backend keeps the Timer0 timebase
  */
 
+/* =======================================
+ *         BRIGHTNESS CURVES
+ * ======================================= */
+
+#define LED_CURVE_LINEAR 0  // Duty proportional to the level
+#define LED_CURVE_GAMMA2 1  // Duty proportional to the level squared
+#define LED_CURVE_CIE1931 2 // CIE 1931 lightness: L* = 10 * level, perceptually even steps
+
+#ifndef LED_CURVE // Override with -DLED_CURVE=... in the project options
+#define LED_CURVE LED_CURVE_LINEAR
+#endif
+
+/* =======================================
+ *            OUTPUT BACKEND
+ * ======================================= */
+/*
+ * LED_BACKEND_PINS: the six lights on their own pins (above), 4 in software
+ * PWM on Timer2 and 2 on the CCP1/CCP2 PWM.
+ * LED_BACKEND_595: every light on a chain of 74HC595 shift registers on RD1
+ * (SER), RD2 (SRCLK) and RD3 (RCLK), up to 64 outputs, output n showing
+ * light n % 6 (a larger room on the same 6 settings). Bit-angle modulation:
+ * 8 bit planes per 20ms period with binary-weighted lengths timed by Timer1
+ * and the CCP1 special event trigger, so 8 interrupts per period whatever
+ * the number of outputs. No dithering or phases: the 8-bit code resolves the
+ * brightness and each bit switches the outputs together. Timer2, CCP2 and
+ * RC1/RC2/RD4 are left free
+ */
+
+// LED_BACKEND and the LED_INTERRUPT_FLAG/LED_DRIVES_TICK it sets live in
+// Board.h, next to the pins of each backend
+
+#ifndef LED_595_CHANNELS
+#define LED_595_CHANNELS 24 // Chain outputs, 8 per 74HC595 (8 to 64)
+#endif
+
+/* =======================================
+ *              CROSSFADE
+ * ======================================= */
+
+#ifndef LED_FADE_MS // Override with -DLED_FADE_MS=... in the project options
+#define LED_FADE_MS 500 // Time a new configuration takes to fade in, in 20ms steps (below 40 = no fade, at most 5100)
+#endif
+
 /* =======================================
  *         PUBLIC FUNCTION HEADERS
  * ======================================= */
 
 void LED_Init(void);
-// Post: Initializes LED ports as outputs and sets all LEDs to OFF (config = 0)
+// Post: Initializes LED ports as outputs, sets all LEDs to OFF (config = 0),
+// starts Timer2 with its interrupt enabled (TMR2IE, PEIE) and CCP1/CCP2 in PWM mode
 
 void LED_Motor(void);
-// Post: Performs PWM control of all LEDs based on current configuration and timer tics
+// Pre: Called from the interrupt when LED_INTERRUPT_FLAG is set
+// Post: Clears it and advances the software PWM (LED0-2, LED5) by one tic,
+// or the chain to the next BAM bit
 
 void LED_UpdateConfig(BYTE *config);
 // Pre: config points to 6-byte array with LED intensities (0-10 for each LED)
-// Post: Updates internal LED configuration array with new values
+// Post: Fills the spare light schedule (targets, fade steps, phases) with the
+// new values; LED_Motor swaps it in whole at the start of the next 20ms
+// period and fades every LED from its current brightness to the new one
+// over LED_FADE_MS
+
+extern const BYTE LED_LEVEL_BRIGHTNESS[];
+// Brightness (0-160) of each level 0-10 on the LED_CURVE curve, in flash
+
+extern const BYTE LED_FADE_PERIODS;
+// 20ms periods a new configuration takes to fade in (LED_FADE_MS)
+
+extern const WORD LED_RAM_BYTES;
+// Bytes of static RAM owned by the module, reported by TMemory
 
 #endif
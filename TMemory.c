@@ -0,0 +1,99 @@
+#include "TMemory.h"
+#include "TTimer.h"
+#include "TSerial.h"
+#include "TLight.h"
+#include "TEEPROM.h"
+#include "TLCD.h"
+#include "TKeypad.h"
+#include "THora.h"
+#include "TRFID.h"
+#include "TController.h"
+
+/* =======================================
+ *              CONSTANTS
+ * ======================================= */
+
+// Return addresses never reach TOSU (8KB flash < 0x2000), so a non-zero TOSU marks an unused level
+#define PAINT_TOSU 0x15
+#define PAINT_TOSH 0xA5
+#define PAINT_TOSL 0x5A
+
+#define STKPTR_LEVEL_MASK 0x1F
+
+#define NUM_MODULES 9
+
+/* =======================================
+ *         PRIVATE VARIABLES
+ * ======================================= */
+
+static const BYTE module_names[NUM_MODULES][12] = {
+    "TTimer", "TSerial", "TLight", "TEEPROM", "TLCD",
+    "TKeypad", "THora", "TRFID", "TController"};
+
+static const WORD *const module_bytes[NUM_MODULES] = {
+    &TI_RAM_BYTES, &SIO_RAM_BYTES, &LED_RAM_BYTES, &EEPROM_RAM_BYTES, &LCD_RAM_BYTES,
+    &KEY_RAM_BYTES, &HORA_RAM_BYTES, &RFID_RAM_BYTES, &CNTR_RAM_BYTES};
+
+/* =======================================
+ *         PUBLIC FUNCTION BODIES
+ * ======================================= */
+
+void MEM_Init(void)
+{
+    BYTE saved_stkptr = STKPTR;
+
+    // Levels above the current one are free: write the marker through TOS
+    for (BYTE level = (saved_stkptr & STKPTR_LEVEL_MASK) + 1; level <= MEM_STACK_LEVELS; level++)
+    {
+        STKPTR = (saved_stkptr & ~STKPTR_LEVEL_MASK) | level;
+        TOSU = PAINT_TOSU;
+        TOSH = PAINT_TOSH;
+        TOSL = PAINT_TOSL;
+    }
+    STKPTR = saved_stkptr;
+}
+
+BYTE MEM_GetStackHighWater(void)
+{
+    BYTE level;
+
+    di(); // An interrupt would push onto the level being inspected
+    BYTE saved_stkptr = STKPTR;
+
+    // Scan from the top: the first level without the marker is the deepest one used
+    for (level = MEM_STACK_LEVELS; level > (saved_stkptr & STKPTR_LEVEL_MASK); level--)
+    {
+        STKPTR = (saved_stkptr & ~STKPTR_LEVEL_MASK) | level;
+        if (TOSU != PAINT_TOSU || TOSH != PAINT_TOSH || TOSL != PAINT_TOSL)
+            break;
+    }
+    STKPTR = saved_stkptr;
+    ei();
+
+    return level;
+}
+
+BYTE MEM_GetNumModules(void)
+{
+    return NUM_MODULES;
+}
+
+const BYTE *MEM_GetModuleName(BYTE module)
+{
+    return module_names[module];
+}
+
+WORD MEM_GetModuleBytes(BYTE module)
+{
+    return *module_bytes[module];
+}
+
+WORD MEM_GetRamAfterStatics(void)
+{
+    WORD used = 0;
+    for (BYTE i = 0; i < NUM_MODULES; i++)
+    {
+        used += *module_bytes[i];
+    }
+    return MEM_RAM_SIZE - used;
+}
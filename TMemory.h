@@ -0,0 +1,58 @@
+#ifndef TMEMORY_H
+#define TMEMORY_H
+
+#include "Utils.h"
+#include <xc.h>
+#include <pic18f4321.h>
+
+/* =======================================
+ *           TMEMORY MODULE
+ * ======================================= */
+/*
+ * MEMORY USAGE MONITOR
+ * - XC8 uses a compiled stack: locals get fixed RAM addresses at link time,
+ *   so the only stack that grows at runtime is the 31-level hardware return stack
+ * - The unused return stack levels are painted at boot and scanned on demand
+ *   to find the deepest call/interrupt nesting ever reached (high-water mark)
+ * - Every module publishes the size of its static variables, collected here
+ *   into a RAM usage table that is reported through the serial menu
+ *
+ * DEPENDENCIES:
+ * - Every TAD module, through its <PREFIX>_RAM_BYTES constant
+ */
+
+/* =======================================
+ *              CONSTANTS
+ * ======================================= */
+
+#define MEM_RAM_SIZE 512    // PIC18F4321 general purpose RAM (bytes)
+#define MEM_STACK_LEVELS 31 // Hardware return stack depth
+
+/* =======================================
+ *         PUBLIC FUNCTION HEADERS
+ * ======================================= */
+
+void MEM_Init(void);
+// Pre: Called first in main, before any interrupt is enabled
+// Post: Paints all return stack levels above the current one with a marker
+
+BYTE MEM_GetStackHighWater(void);
+// Post: Returns the deepest return stack level used since MEM_Init (0-31)
+
+BYTE MEM_GetNumModules(void);
+// Post: Returns the number of entries in the RAM usage table
+
+const BYTE *MEM_GetModuleName(BYTE module);
+// Pre: module < MEM_GetNumModules()
+// Post: Returns the module name (null terminated, in flash)
+
+WORD MEM_GetModuleBytes(BYTE module);
+// Pre: module < MEM_GetNumModules()
+// Post: Returns the bytes of static RAM owned by the module
+
+WORD MEM_GetRamAfterStatics(void);
+// Post: Returns MEM_RAM_SIZE minus all module statics. This is not free RAM: the
+//       XC8 compiled stack (locals, parameters, temporaries) lives in it, and
+//       only the linker map tells its size
+
+#endif
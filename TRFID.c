@@ -38,6 +38,9 @@ static BOOL rfid_card_detected = FALSE;
 static BYTE card_uid[5] = {0};
 static BYTE card_data_position = 0;
 
+const WORD RFID_RAM_BYTES = sizeof(rfid_reading_state) + sizeof(retry_counter) + sizeof(rfid_card_detected) +
+                           sizeof(card_uid) + sizeof(card_data_position);
+
 /* =======================================
  *       PRIVATE FUNCTION HEADERS
  * ======================================= */
@@ -55,7 +58,7 @@ static void mfrc522_antenna_off(void);
 static void mfrc522_initialize_chip(void);
 
 // RFID card detection and reading functions
-static BYTE mfrc522_send_command_to_card(BYTE command, BYTE *send_data, BYTE send_len, BYTE *back_data, WORD *back_len);
+static BYTE mfrc522_send_command_to_card(BYTE command, BYTE *send_data, BYTE send_len, BYTE *back_data, BYTE back_size, WORD *back_len);
 static void mfrc522_calculate_crc(BYTE *data_in, BYTE length, BYTE *data_out);
 static BYTE mfrc522_anticollision_detection(BYTE *serial_number);
 static BYTE mfrc522_read_card_uid(BYTE *uid_buffer);
@@ -303,7 +306,7 @@ static BYTE mfrc522_anticollision_detection(BYTE *serial_number)
   serial_number[1] = 0x20;
   mfrc522_clear_register_bit(0x08, 0x08);
 
-  status = mfrc522_send_command_to_card(PCD_TRANSCEIVE, serial_number, 2, serial_number, &response_length);
+  status = mfrc522_send_command_to_card(PCD_TRANSCEIVE, serial_number, 2, serial_number, RFID_UID_LENGTH, &response_length);
   if (status == MI_OK)
   {
     // Verify checksum
@@ -318,7 +321,6 @@ static BYTE mfrc522_anticollision_detection(BYTE *serial_number)
 static BYTE mfrc522_read_card_uid(BYTE *uid_buffer)
 {
   BYTE status = mfrc522_anticollision_detection(uid_buffer);
-  uid_buffer[5] = 0;
   return status == MI_OK;
 }
 
@@ -330,7 +332,7 @@ static void mfrc522_halt_card_communication(void)
   halt_command[1] = 0;
   mfrc522_calculate_crc(halt_command, 2, &halt_command[2]);
   mfrc522_clear_register_bit(0x08, 0x80);
-  mfrc522_send_command_to_card(PCD_TRANSCEIVE, halt_command, 4, halt_command, &response_length);
+  mfrc522_send_command_to_card(PCD_TRANSCEIVE, halt_command, 4, halt_command, sizeof(halt_command), &response_length);
   mfrc522_clear_register_bit(0x08, 0x08);
 }
 
@@ -355,7 +357,7 @@ static void mfrc522_calculate_crc(BYTE *data_in, BYTE length, BYTE *data_out)
   data_out[1] = mfrc522_read_register(0x21);
 }
 
-static BYTE mfrc522_send_command_to_card(BYTE command, BYTE *send_data, BYTE send_len, BYTE *back_data, WORD *back_len)
+static BYTE mfrc522_send_command_to_card(BYTE command, BYTE *send_data, BYTE send_len, BYTE *back_data, BYTE back_size, WORD *back_len)
 {
   BYTE status = MI_ERR;
   BYTE irq_enable = 0, wait_irq = 0;
@@ -404,13 +406,13 @@ static BYTE mfrc522_send_command_to_card(BYTE command, BYTE *send_data, BYTE sen
       n = mfrc522_read_register(0x0A);
       last_bits = mfrc522_read_register(0x0C) & 0x07;
       *back_len = last_bits ? ((n - 1) * 8 + last_bits) : (n * 8);
+      // Never copy more than back_data holds
       if (n == 0)
         n = 1;
-      else if (n > 16)
-        n = 16;
+      else if (n > back_size)
+        n = back_size;
       for (i = 0; i < n; i++)
         back_data[i] = mfrc522_read_register(0x09);
-      back_data[i] = 0;
     }
   }
   return status;
@@ -4,34 +4,38 @@
 #include <xc.h>
 #include <pic18f4321.h>
 #include "Utils.h"
+#include "Board.h"
 
 /* RFID-RC522 Pin Configuration
  * New pin assignments:
  * SDA (CS): RC0 - Chip Select (Slave Select)
- * SCK:      RC1 - Serial Clock
- * MOSI:     RC2 - Master Output Slave Input
+ * SCK:      RC4 - Serial Clock
+ * MOSI:     RC5 - Master Output Slave Input
  * MISO:     RC3 - Master Input Slave Output
  * IRQ:      Not connected
  * GND:      Ground
  * RST:      RD0 - Reset
  * 3V3:      3V3 power supply
+ *
+ * SCK and MOSI stay off RC1/RC2: those are the CCP2/CCP1 PWM outputs (TLight)
+ * Pins come from Board.h
  */
 
 //------------------------------------------------
 // RFID SPI Pin Definitions (Updated Configuration)
 //-------------------------------------------------
-#define MFRC522_SO PORTCbits.RC3   // input  (Master Input from Slave Output - MISO)
-#define MFRC522_SI LATCbits.LATC2  // output (Master Output to Slave Input - MOSI)
-#define MFRC522_SCK LATCbits.LATC1 // output (Serial Clock)
-#define MFRC522_CS LATCbits.LATC0  // output (Chip Select - SDA pin on RC522 module)
-#define MFRC522_RST LATDbits.LATD0 // output (Reset)
+#define MFRC522_SO BOARD_PIN(BOARD_RFID_SO)   // input  (Master Input from Slave Output - MISO)
+#define MFRC522_SI BOARD_LAT(BOARD_RFID_SI)   // output (Master Output to Slave Input - MOSI)
+#define MFRC522_SCK BOARD_LAT(BOARD_RFID_SCK) // output (Serial Clock)
+#define MFRC522_CS BOARD_LAT(BOARD_RFID_CS)   // output (Chip Select - SDA pin on RC522 module)
+#define MFRC522_RST BOARD_LAT(BOARD_RFID_RST) // output (Reset)
 
 // Pin Direction Configuration
-#define DIR_MFRC522_SO TRISCbits.TRISC3  // input  (MISO)
-#define DIR_MFRC522_SI TRISCbits.TRISC2  // output (MOSI)
-#define DIR_MFRC522_SCK TRISCbits.TRISC1 // output (Serial Clock)
-#define DIR_MFRC522_CS TRISCbits.TRISC0  // output (Chip Select)
-#define DIR_MFRC522_RST TRISDbits.TRISD0 // output (Reset)
+#define DIR_MFRC522_SO BOARD_TRIS(BOARD_RFID_SO)   // input  (MISO)
+#define DIR_MFRC522_SI BOARD_TRIS(BOARD_RFID_SI)   // output (MOSI)
+#define DIR_MFRC522_SCK BOARD_TRIS(BOARD_RFID_SCK) // output (Serial Clock)
+#define DIR_MFRC522_CS BOARD_TRIS(BOARD_RFID_CS)   // output (Chip Select)
+#define DIR_MFRC522_RST BOARD_TRIS(BOARD_RFID_RST) // output (Reset)
 
 //------------------------------------------------
 // MFRC522 Commands (only used ones)
@@ -75,4 +79,7 @@ BOOL RFID_GetReadUserId(BYTE *rfid_uid);
 // Pre: RFID_HasReadUser() must return TRUE
 // Post: Fills the rfid_uid position by position while returning FALSE. Returns TRUE once done
 
+extern const WORD RFID_RAM_BYTES;
+// Bytes of static RAM owned by the module, reported by TMemory
+
 #endif
@@ -1,10 +1,25 @@
 #include "TSerial.h"
+#include "TEEPROM.h"
 
 /* =======================================
  *         PRIVATE CONSTANTS
  * ======================================= */
-#define UID_BASE_STRING "AA-BB-CC-DD-EE"
-#define CONFIG_BUFFER_SIZE sizeof("L0: 0 - L1: 3 - L2: 9 - L3: A - L4: 0 - L5: 9")
+
+// Placeholders in the flash templates, each one consumes the next value
+#define TEMPLATE_BYTE '%'  // Value sent as two hex digits
+#define TEMPLATE_DIGIT '#' // Value sent as a single hex digit (0-A)
+
+// Baud rate generator with BRG16 = 1 and BRGH = 1: baud = FOSC / (4 * (n + 1))
+#define FOSC 32000000UL
+#define BRG_DIVISOR(baud) ((WORD)(((FOSC + 2UL * (baud)) / (4UL * (baud))) - 1)) // Rounded at compile time
+
+// Auto-baud states: the hardware measures a 'U', then a second 'U' has to
+// arrive intact at the measured rate before it is kept
+#define AUTO_BAUD_OFF 0
+#define AUTO_BAUD_MEASURING 1
+#define AUTO_BAUD_CONFIRMING 2
+#define AUTO_BAUD_CONFIRM_CHAR 'U'
+#define AUTO_BAUD_TOLERANCE_SHIFT 5 // A measure within 1/32 (+1) of a table divisor snaps to it
 
 // SIO_ReadTime state machine states
 #define TIME_STATE_HOUR_FIRST 0
@@ -18,24 +33,49 @@
 
 // Optimized string constants (reduced memory usage)
 static const BYTE msg_crlf[] = "\r\n";
-static const BYTE msg_main_menu[] = "---------------\r\n    Main Menu\r\n---------------\r\nChoose:\r\n    1.Who in room?\r\n    2.Show configs\r\n    3.Modify time\r\nOption: ";
+static const BYTE msg_main_menu[] = "---------------\r\n    Main Menu\r\n---------------\r\nChoose:\r\n    1.Who in room?\r\n    2.Show configs\r\n    3.Modify time\r\n    4.Baud rate\r\n    5.Memory usage\r\nOption: ";
+static const BYTE msg_baud_menu[] = "Baud rate:\r\n    0.9600\r\n    1.19200\r\n    2.38400\r\n    3.57600\r\n    4.115200\r\n    5.250000\r\n    A.Auto (send 'U' twice)\r\nOption: ";
+
+// Divisors for the SIO_BAUD_xxx rates, all below 1% error at 32 MHz
+static const WORD baud_divisors[SIO_NUM_BAUDS] = {
+    BRG_DIVISOR(9600),   // 832
+    BRG_DIVISOR(19200),  // 416
+    BRG_DIVISOR(38400),  // 207
+    BRG_DIVISOR(57600),  // 138
+    BRG_DIVISOR(115200), // 68
+    BRG_DIVISOR(250000)  // 31
+};
 
-// Buffer for UID formatting
-static BYTE uid_buffer[] = UID_BASE_STRING;
+// AUTO_BAUD_xxx: waiting for the 'U' that measures the PC baud rate, or for
+// the one that confirms it
+static BYTE auto_baud_state = AUTO_BAUD_OFF;
 
-// Buffer for config formatting
-static BYTE config_buffer[CONFIG_BUFFER_SIZE];
+// SIO_ReadTime progress (TIME_STATE_xxx) and the digits typed so far
+static BYTE time_state = TIME_STATE_HOUR_FIRST;
+static BYTE hour_chars[2], min_chars[2];
+
+const WORD SIO_RAM_BYTES = sizeof(auto_baud_state) + sizeof(time_state) + sizeof(hour_chars) + sizeof(min_chars);
+
+// Output templates, streamed straight to TXREG (no RAM buffers)
+static const BYTE uid_template[] = "%-%-%-%-%";
+static const BYTE config_template[] = "L0: # - L1: # - L2: # - L3: # - L4: # - L5: #";
 
 /* =======================================
  *        PRIVATE FUNCTION HEADERS
  * ======================================= */
 
 static BOOL send_char(BYTE character);
+static void send_char_blocking(BYTE character);
 static void send_string(BYTE *string);
+static void send_template(const BYTE *pattern, const BYTE *values);
+static void send_decimal(WORD value);
 static void clear_before_new_message(void);
-static void format_uid(const BYTE *uid);
-static void format_config(const BYTE *config);
 static BYTE hex_char(BYTE val);
+static void set_divisor(WORD divisor);
+static void start_auto_baud(void);
+static BYTE check_auto_baud(void);
+static BYTE snap_divisor(WORD measured);
+static void wait_transmit_done(void);
 
 /* =======================================
  *         PUBLIC FUNCTION BODIES
@@ -47,33 +87,80 @@ void SIO_Init(void)
     TRISCbits.TRISC7 = 1; // RX input
 
     TXSTAbits.BRGH = 1;
-    BAUDCONbits.BRG16 = 0;
-    SPBRG = 207; // 9600 baud @ 32 MHz
+    BAUDCONbits.BRG16 = 1; // 16-bit divisor, fine steps at high rates
 
     TXSTAbits.SYNC = 0;
     TXSTAbits.TXEN = 1;
     RCSTAbits.SPEN = 1;
     RCSTAbits.CREN = 1;
+
+    WORD divisor = EEPROM_ReadBaudDivisor();
+    if (divisor == EEPROM_NO_BAUD_DIVISOR)
+    {
+        // Nothing stored yet: 9600, auto-baud only from the baud rate menu
+        divisor = baud_divisors[SIO_BAUD_9600];
+    }
+    set_divisor(divisor);
 }
 
-BOOL SIO_ReadTime(BYTE *hour, BYTE *mins)
+BOOL SIO_ReadBaudRate(void)
 {
-    static BYTE state = TIME_STATE_HOUR_FIRST;
-    static BYTE hour_chars[2], min_chars[2];
+    if (!PIR1bits.RC1IF)
+        return FALSE;
 
+    BYTE received_char = RCREG;
+    send_char(received_char);
+
+    if (received_char >= '0' && received_char < '0' + SIO_NUM_BAUDS)
+    {
+        send_string((BYTE *)"\r\nSwitching baud rate...\r\n");
+        SIO_SetBaudRate(received_char - '0');
+        SIO_SendMainMenu();
+        return TRUE;
+    }
+
+    if (received_char == 'A' || received_char == 'a')
+    {
+        send_string((BYTE *)"\r\nSend 'U' twice at the new baud rate.\r\n");
+        wait_transmit_done();
+        start_auto_baud();
+        return TRUE;
+    }
+
+    if (received_char == ASCII_ESC)
+    {
+        SIO_SendMainMenu();
+        return TRUE;
+    }
+
+    return FALSE;
+}
+
+void SIO_SetBaudRate(BYTE baud)
+{
+    if (baud >= SIO_NUM_BAUDS)
+        return;
+
+    wait_transmit_done();
+    set_divisor(baud_divisors[baud]);
+    EEPROM_StoreBaudDivisor(baud_divisors[baud]);
+}
+
+BOOL SIO_ReadTime(BYTE *hour, BYTE *mins)
+{
     if (!PIR1bits.RC1IF)
         return FALSE;
 
     BYTE received_char = RCREG;
     send_char(received_char);
 
-    switch (state)
+    switch (time_state)
     {
     case TIME_STATE_HOUR_FIRST: // First hour digit
         if (received_char >= '0' && received_char <= '9')
         {
             hour_chars[0] = received_char;
-            state = TIME_STATE_HOUR_SECOND;
+            time_state = TIME_STATE_HOUR_SECOND;
         }
         break;
 
@@ -81,10 +168,9 @@ BOOL SIO_ReadTime(BYTE *hour, BYTE *mins)
         if (received_char >= '0' && received_char <= '9')
         {
             hour_chars[1] = received_char;
-            *hour = (hour_chars[0] - '0') * 10 + (hour_chars[1] - '0');
-            while (!send_char(':'))
-                ;
-            state = TIME_STATE_MIN_FIRST;
+            *hour = ((hour_chars[0] - '0') << 4) | (hour_chars[1] - '0'); // BCD
+            send_char_blocking(':');
+            time_state = TIME_STATE_MIN_FIRST;
         }
         break;
 
@@ -92,7 +178,7 @@ BOOL SIO_ReadTime(BYTE *hour, BYTE *mins)
         if (received_char >= '0' && received_char <= '9')
         {
             min_chars[0] = received_char;
-            state = TIME_STATE_MIN_SECOND;
+            time_state = TIME_STATE_MIN_SECOND;
         }
         break;
 
@@ -100,11 +186,11 @@ BOOL SIO_ReadTime(BYTE *hour, BYTE *mins)
         if (received_char >= '0' && received_char <= '9')
         {
             min_chars[1] = received_char;
-            *mins = (min_chars[0] - '0') * 10 + (min_chars[1] - '0');
+            *mins = ((min_chars[0] - '0') << 4) | (min_chars[1] - '0'); // BCD
             send_string((BYTE *)msg_crlf);
 
-            // Reset state for next time
-            state = TIME_STATE_HOUR_FIRST;
+            // Reset time_state for next time
+            time_state = TIME_STATE_HOUR_FIRST;
             clear_before_new_message();
             send_string((BYTE *)"Time updated successfully.\r\n");
             return TRUE;
@@ -117,6 +203,9 @@ BOOL SIO_ReadTime(BYTE *hour, BYTE *mins)
 
 BYTE SIO_ReadCommand(void)
 {
+    if (auto_baud_state != AUTO_BAUD_OFF)
+        return check_auto_baud();
+
     if (!PIR1bits.RC1IF)
         return CMD_NO_COMMAND;
 
@@ -132,6 +221,10 @@ BYTE SIO_ReadCommand(void)
         return CMD_SHOW_STORED_CONF;
     case ASCII_3:
         return CMD_UPDATE_TIME;
+    case ASCII_4:
+        return CMD_SET_BAUD;
+    case ASCII_5:
+        return CMD_MEMORY_REPORT;
     case ASCII_ESC:
         return CMD_ESC;
     default:
@@ -141,14 +234,11 @@ BYTE SIO_ReadCommand(void)
 
 void SIO_SendDetectedCard(const BYTE *uid_bytes, const BYTE *config)
 {
-    format_uid(uid_bytes);
-    format_config(config);
-
     clear_before_new_message();
     send_string((BYTE *)"Card detected!\r\nUID: ");
-    send_string(uid_buffer);
+    send_template(uid_template, uid_bytes);
     send_string((BYTE *)msg_crlf);
-    send_string(config_buffer);
+    send_template(config_template, config);
     send_string((BYTE *)msg_crlf);
 }
 
@@ -160,11 +250,9 @@ void SIO_SendMainMenu(void)
 
 void SIO_SendUser(const BYTE *uid_bytes)
 {
-    format_uid(uid_bytes);
-
     send_string((BYTE *)msg_crlf);
     send_string((BYTE *)"Current user: UID ");
-    send_string(uid_buffer);
+    send_template(uid_template, uid_bytes);
     send_string((BYTE *)msg_crlf);
 }
 
@@ -176,14 +264,11 @@ void SIO_SendNoUser(void)
 
 void SIO_SendStoredConfig(const BYTE *uid_bytes, const BYTE *config)
 {
-    format_uid(uid_bytes);
-    format_config(config);
-
     clear_before_new_message();
     send_string((BYTE *)"UID: ");
-    send_string(uid_buffer);
+    send_template(uid_template, uid_bytes);
     send_string((BYTE *)" -> ");
-    send_string(config_buffer);
+    send_template(config_template, config);
     send_string((BYTE *)msg_crlf);
 }
 
@@ -195,14 +280,33 @@ void SIO_SendTimePrompt(void)
 
 void SIO_SendUnknownCard(const BYTE *uid_bytes)
 {
-    format_uid(uid_bytes);
-
     clear_before_new_message();
     send_string((BYTE *)"Card detected!\r\nUnknown UID: ");
-    send_string(uid_buffer);
+    send_template(uid_template, uid_bytes);
     send_string((BYTE *)"\r\nCard not recognized. Ignored.\r\n");
 }
 
+void SIO_SendBaudPrompt(void)
+{
+    clear_before_new_message();
+    send_string((BYTE *)msg_baud_menu);
+}
+
+void SIO_SendMemoryHeader(void)
+{
+    clear_before_new_message();
+    send_string((BYTE *)"Memory usage (return stack levels / RAM bytes):\r\n");
+}
+
+void SIO_SendMemoryItem(const BYTE *name, WORD value)
+{
+    send_string((BYTE *)"    ");
+    send_string((BYTE *)name);
+    send_string((BYTE *)": ");
+    send_decimal(value);
+    send_string((BYTE *)msg_crlf);
+}
+
 void SIO_SendKeyReset(void)
 {
     send_string((BYTE *)"\r\nKeypad RESET Triggered! Cleaning up...");
@@ -222,65 +326,146 @@ static BOOL send_char(BYTE character)
     return TRUE;
 }
 
+static void send_char_blocking(BYTE character)
+{
+    while (!send_char(character))
+        ;
+}
+
 static void send_string(BYTE *string)
 {
     BYTE i = 0;
     while (string[i] != '\0')
     {
-        while (!send_char(string[i]))
-            ;
+        send_char_blocking(string[i]);
         i++;
     }
 }
 
+static void send_template(const BYTE *pattern, const BYTE *values)
+{
+    // Copies the template to the UART, replacing each placeholder with the next value
+    while (*pattern != '\0')
+    {
+        if (*pattern == TEMPLATE_BYTE)
+        {
+            send_char_blocking(hex_char(*values >> 4));
+            send_char_blocking(hex_char(*values & 0x0F));
+            values++;
+        }
+        else if (*pattern == TEMPLATE_DIGIT)
+        {
+            send_char_blocking(hex_char(*values));
+            values++;
+        }
+        else
+        {
+            send_char_blocking(*pattern);
+        }
+        pattern++;
+    }
+}
+
+static void send_decimal(WORD value)
+{
+    // Repeated subtraction, avoids the software division on the PIC18
+    BYTE hundreds = 0, tens = 0;
+    while (value >= 100)
+    {
+        value -= 100;
+        hundreds++;
+    }
+    while (value >= 10)
+    {
+        value -= 10;
+        tens++;
+    }
+
+    if (hundreds)
+        send_char_blocking('0' + hundreds);
+    if (hundreds || tens)
+        send_char_blocking('0' + tens);
+    send_char_blocking('0' + (BYTE)value);
+}
+
 static void clear_before_new_message(void)
 {
     send_string((BYTE *)msg_crlf);
     send_string((BYTE *)msg_crlf);
 }
 
-static void format_uid(const BYTE *uid)
+static BYTE hex_char(BYTE val)
 {
-    uid_buffer[0] = hex_char((uid[0] >> 4) & 0x0F);
-    uid_buffer[1] = hex_char(uid[0] & 0x0F);
-
-    uid_buffer[3] = hex_char((uid[1] >> 4) & 0x0F);
-    uid_buffer[4] = hex_char(uid[1] & 0x0F);
-
-    uid_buffer[6] = hex_char((uid[2] >> 4) & 0x0F);
-    uid_buffer[7] = hex_char(uid[2] & 0x0F);
+    if (val < 10)
+        return '0' + val;
+    return 'A' + val - 10;
+}
 
-    uid_buffer[9] = hex_char((uid[3] >> 4) & 0x0F);
-    uid_buffer[10] = hex_char((uid[3] & 0x0F));
+static void set_divisor(WORD divisor)
+{
+    SPBRGH = (BYTE)(divisor >> 8);
+    SPBRG = (BYTE)divisor;
+}
 
-    uid_buffer[12] = hex_char((uid[4] >> 4) & 0x0F);
-    uid_buffer[13] = hex_char(uid[4] & 0x0F);
+static void start_auto_baud(void)
+{
+    BAUDCONbits.ABDOVF = 0;
+    BAUDCONbits.ABDEN = 1; // Hardware clears it after the fifth rising edge on RX
+    auto_baud_state = AUTO_BAUD_MEASURING;
 }
 
-static void format_config(const BYTE *config)
+static BYTE check_auto_baud(void)
 {
-    BYTE pos = 0;
-    for (BYTE i = 0; i < 6; i++) // 6 LEDs
+    if (!PIR1bits.RC1IF || (auto_baud_state == AUTO_BAUD_MEASURING && BAUDCONbits.ABDEN))
+        return CMD_NO_COMMAND; // Still waiting for the 'U'
+
+    // Clears RCIF. After a measure the character is meaningless: the
+    // hardware timed edges, it did not receive it
+    BYTE received_char = RCREG;
+
+    if (auto_baud_state == AUTO_BAUD_MEASURING)
     {
-        if (i > 0)
+        // Any character other than 'U' times the wrong edges: keep only a
+        // measure that lands on one of the selectable rates, otherwise (or
+        // when the counter overflowed) measure the next character again
+        BYTE baud = snap_divisor(((WORD)SPBRGH << 8) | SPBRG);
+        if (BAUDCONbits.ABDOVF || baud == SIO_NUM_BAUDS)
         {
-            config_buffer[pos++] = ' ';
-            config_buffer[pos++] = '-';
-            config_buffer[pos++] = ' ';
+            start_auto_baud();
+            return CMD_NO_COMMAND;
         }
+        set_divisor(baud_divisors[baud]);
+        auto_baud_state = AUTO_BAUD_CONFIRMING;
+        return CMD_NO_COMMAND;
+    }
 
-        config_buffer[pos++] = 'L';
-        config_buffer[pos++] = i + '0';
-        config_buffer[pos++] = ':';
-        config_buffer[pos++] = ' ';
-        config_buffer[pos++] = hex_char(config[i]);
+    // Received at the measured rate: only an intact 'U' proves it right
+    if (received_char != AUTO_BAUD_CONFIRM_CHAR)
+    {
+        start_auto_baud();
+        return CMD_NO_COMMAND;
     }
-    config_buffer[pos] = '\0';
+    auto_baud_state = AUTO_BAUD_OFF;
+    EEPROM_StoreBaudDivisor(((WORD)SPBRGH << 8) | SPBRG);
+    return CMD_BAUD_DETECTED;
 }
 
-static BYTE hex_char(BYTE val)
+static BYTE snap_divisor(WORD measured)
 {
-    if (val < 10)
-        return '0' + val;
-    return 'A' + val - 10;
+    // Index of the table divisor the measure is close to, SIO_NUM_BAUDS if none
+    for (BYTE baud = 0; baud < SIO_NUM_BAUDS; baud++)
+    {
+        WORD divisor = baud_divisors[baud];
+        WORD tolerance = (divisor >> AUTO_BAUD_TOLERANCE_SHIFT) + 1;
+        if (measured + tolerance >= divisor && measured <= divisor + tolerance)
+            return baud;
+    }
+    return SIO_NUM_BAUDS;
+}
+
+static void wait_transmit_done(void)
+{
+    // TXREG empty and shift register empty: the last stop bit has left the pin
+    while (!PIR1bits.TXIF || !TXSTAbits.TRMT)
+        ;
 }
@@ -10,7 +10,12 @@
  * ======================================= */
 /*
  * HARDWARE CONFIGURATION:
- * - UART communication at 9600 baud
+ * - UART communication, 16-bit baud generator (BRG16 = 1, BRGH = 1)
+ * - Selectable rates from 9600 up to 250000 baud, divisors computed at compile time
+ * - Auto-baud (ABDEN), from the baud rate menu only: a 'U' (0x55) measures
+ *   the PC rate, which must be one of the selectable ones, and a second 'U'
+ *   received intact at that rate confirms it before it is persisted
+ * - Preferred rate persisted in EEPROM (9600 when none stored)
  * - Pin assignments:
  *   * TX: RC6 - Transmit data to PC
  *   * RX: RC7 - Receive data from PC
@@ -22,6 +27,7 @@
  *
  * DEPENDENCIES:
  * - PIC18F4321 UART hardware module
+ * - TEEPROM module to persist the preferred baud rate
  * - Utils.h for data types
  */
 
@@ -35,11 +41,25 @@
 #define CMD_SHOW_STORED_CONF 2
 #define CMD_UPDATE_TIME 3
 #define CMD_ESC 4
+#define CMD_SET_BAUD 5
+#define CMD_BAUD_DETECTED 6 // Auto-baud locked, menu has to be resent at the new rate
+#define CMD_MEMORY_REPORT 7
+
+// Selectable baud rates (index into the divisor table)
+#define SIO_BAUD_9600 0
+#define SIO_BAUD_19200 1
+#define SIO_BAUD_38400 2
+#define SIO_BAUD_57600 3
+#define SIO_BAUD_115200 4
+#define SIO_BAUD_250000 5
+#define SIO_NUM_BAUDS 6
 
 // ASCII character defines
 #define ASCII_1 '1'
 #define ASCII_2 '2'
 #define ASCII_3 '3'
+#define ASCII_4 '4'
+#define ASCII_5 '5'
 #define ASCII_ESC 27
 
 /* =======================================
@@ -56,7 +76,18 @@ BYTE SIO_ReadCommand(void);
 
 BOOL SIO_ReadTime(BYTE *hour, BYTE *mins);
 // Pre: Serial hardware is initialized, hour and mins point to valid BYTE variables
-// Post: Returns FALSE until both hour and mins are filled; reads HH:MM format from serial
+// Post: Returns FALSE until both hour and mins are filled; reads HH:MM format from serial,
+// each field as packed BCD (digits only, not range checked: THora does)
+
+BOOL SIO_ReadBaudRate(void);
+// Pre: SIO_SendBaudPrompt() has been sent
+// Post: Returns FALSE until a valid option is received. '0'-'5' switches to that rate and persists it,
+// 'A' arms auto-baud (SIO_ReadCommand returns CMD_BAUD_DETECTED once two 'U' have set the rate),
+// ESC keeps the current rate. Returns TRUE once handled
+
+void SIO_SetBaudRate(BYTE baud);
+// Pre: baud is one of SIO_BAUD_xxx, no transmission in progress is lost (waits for TRMT)
+// Post: EUSART runs at the selected rate and it is stored as the preferred one
 
 // Specific message functions
 void SIO_SendDetectedCard(const BYTE *uid_bytes, const BYTE *config);
@@ -84,7 +115,20 @@ void SIO_SendUnknownCard(const BYTE *uid_bytes);
 // Pre: uid_bytes points to 5-byte UID array
 // Post: Sends unknown card message to PC
 
+void SIO_SendBaudPrompt(void);
+// Post: Sends the list of selectable baud rates to PC
+
+void SIO_SendMemoryHeader(void);
+// Post: Sends the memory report title to PC
+
+void SIO_SendMemoryItem(const BYTE *name, WORD value);
+// Pre: name is null terminated, value < 1000
+// Post: Sends one "name: value" line of the memory report to PC
+
 void SIO_SendKeyReset(void);
 // Post: Sends keypad reset message to PC
 
+extern const WORD SIO_RAM_BYTES;
+// Bytes of static RAM owned by the module, reported by TMemory
+
 #endif
@@ -1,4 +1,5 @@
 #include "TTimer.h"
+#include "Board.h"
 
 // TMR0 ON | 16-bit | Prescaler 1:8 | Internal Clock
 // Bit 7: TMR0ON = 1
@@ -19,10 +20,19 @@ struct Timer
 
 static volatile WORD Tics = 0;
 
+const WORD TI_RAM_BYTES = sizeof(Timers) + sizeof(Tics);
+
 void Timer0_ISR()
 {
-    TMR0 = TMR0_INT_2MS;
+    // Add instead of load: the counts since the overflow (interrupt latency)
+    // stay in this period, so the 2ms tick does not drift
+    TMR0 = TMR0 + TMR0_INT_2MS;
     TMR0IF = 0;
+    TiTick();
+}
+
+void TiTick()
+{
     Tics++;
 }
 
@@ -32,10 +42,14 @@ void TiInit()
     {
         Timers[counter].Busy = FALSE;
     }
+#if !LED_DRIVES_TICK
+    // Tick on Timer0. Otherwise the LED Timer2 interrupt already comes every
+    // 2ms, reloaded by hardware, and ticks instead (LED_Init starts it)
     T0CON = T0CON_CONFIG;
     TMR0 = TMR0_INT_2MS;
     INTCONbits.TMR0IF = 0;
     INTCONbits.TMR0IE = 1;
+#endif
 
     // Set internal oscillator to 8 MHz
     OSCCONbits.IRCF = 0b111; // IRCF = 111: 8 MHz
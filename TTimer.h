@@ -12,13 +12,18 @@
 
 #define TI_RFID 0
 #define TI_KEYPAD 1
-#define TI_LIGHTS 2
-#define TI_LCD 3
-#define TI_HORA 4
-#define TI_TEST 5
-#define TI_CNTR 6
+#define TI_LCD 2
+#define TI_HORA 3
+#define TI_TEST 4
+#define TI_CNTR 5
 
 void Timer0_ISR(void);
+// Pre: Called from the interrupt when TMR0IF is set (LED_DRIVES_TICK = 0)
+// Post: Reloads Timer0 for the next 2ms and ticks
+
+void TiTick(void);
+// Pre: Called from the interrupt every 2ms (Timer0_ISR, or the Timer2 interrupt when LED_DRIVES_TICK)
+// Post: Advances the tick count every timer measures from
 
 void TiInit(void);
 // Post: Constructor. It is a global precondition to have called this function before calling any other function of the TAD.
@@ -31,4 +36,7 @@ WORD TiGetTics(BYTE TimerHandle);
 // Pre: Handle has been returned by TiNewTimer.
 // Post: Returns the number of ticks elapsed since the call to TI_ResetTics for the same TimerHandle.
 
+extern const WORD TI_RAM_BYTES;
+// Bytes of static RAM owned by the module, reported by TMemory
+
 #endif
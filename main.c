@@ -2,6 +2,7 @@
 #include <pic18f4321.h>
 
 #include "Utils.h"
+#include "Board.h"
 #include "TTimer.h"
 #include "TSerial.h"
 #include "TLight.h"
@@ -11,6 +12,7 @@
 #include "THora.h"
 #include "TRFID.h"
 #include "TController.h"
+#include "TMemory.h"
 
 // Configuration bits
 #pragma config OSC = INTIO2
@@ -21,6 +23,7 @@
 #pragma config BOR = OFF
 #pragma config WDT = OFF
 #pragma config LVP = OFF
+#pragma config CCP2MX = RC1
 
 void main(void);
 
@@ -33,11 +36,25 @@ void __interrupt() RSI_High(void)
 void RSI_High(void) // For IntelliSense only
 #endif
 {
+#if LED_DRIVES_TICK
+    // A single 2ms source: the PWM tic first, then the timebase and keypad
+    if (LED_INTERRUPT_FLAG == 1)
+    {
+        LED_Motor();
+        TiTick();
+        KEY_ScanISR();
+    }
+#else
     if (INTCONbits.TMR0IF == 1)
     {
         Timer0_ISR();
+        KEY_ScanISR();
+    }
+    if (LED_INTERRUPT_FLAG == 1)
+    {
         LED_Motor();
     }
+#endif
 }
 
 /* =======================================
@@ -45,11 +62,12 @@ void RSI_High(void) // For IntelliSense only
  * ======================================= */
 void main(void)
 {
-    TRISEbits.TRISE2 = 0;
+    MEM_Init(); // Paint the return stack before anything can nest calls
+    BOARD_TRIS(BOARD_LOOP_MARKER) = 0;
     // Initialize all modules in proper order
-    TiInit();      // Timer system (must be first)
+    TiInit();      // Timer system (must be first, ticks once LED_Init starts Timer2 on the pins backend)
     SIO_Init();    // Serial communication
-    LED_Init();    // PWM light control
+    LED_Init();    // PWM light control (Timer2, or Timer1 on the 595 chain)
     EEPROM_Init(); // EEPROM storage
     LCD_Init();    // LCD display
     KEY_Init();    // Keypad input
@@ -60,7 +78,7 @@ void main(void)
     // Main cooperative loop
     while (TRUE)
     {
-        LATEbits.LATE2 ^= 1;
+        BOARD_LAT(BOARD_LOOP_MARKER) ^= 1;
         // Run all hardware module motors
         KEY_Motor();  // Process keypad input
         HORA_Motor(); // Update time management
@@ -0,0 +1,50 @@
+#include "Hc595.h"
+
+namespace sim
+{
+    /* =======================================
+     *              CONSTANTS
+     * ======================================= */
+
+    constexpr uint8_t kSer = 0x02;   // RD1
+    constexpr uint8_t kSrclk = 0x04; // RD2
+    constexpr uint8_t kRclk = 0x08;  // RD3
+
+    /* =======================================
+     *                CHAIN
+     * ======================================= */
+
+    Hc595Chain *Hc595Chain::current_ = nullptr;
+
+    Hc595Chain::Hc595Chain(Pic18 &mcu, int size)
+        : size_(size), shift_(0), outputs_(0), clock_(false), latch_(false), latches_(0)
+    {
+        mcu.attach(this);
+        current_ = this;
+    }
+
+    Hc595Chain::~Hc595Chain()
+    {
+        if (current_ == this)
+            current_ = nullptr;
+    }
+
+    void Hc595Chain::onPinsChanged(Pic18 &mcu, int port)
+    {
+        if (port != PortD)
+            return;
+        uint8_t pins = mcu.outputs(PortD);
+        bool clock = (pins & kSrclk) != 0;
+        bool latch = (pins & kRclk) != 0;
+        uint64_t mask = size_ >= 64 ? ~0ull : (1ull << size_) - 1;
+        if (clock && !clock_)
+            shift_ = ((shift_ << 1) | ((pins & kSer) ? 1 : 0)) & mask;
+        if (latch && !latch_)
+        {
+            outputs_ = shift_;
+            latches_++;
+        }
+        clock_ = clock;
+        latch_ = latch;
+    }
+}
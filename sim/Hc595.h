@@ -0,0 +1,52 @@
+#ifndef SIM_HC595_H
+#define SIM_HC595_H
+
+#include "Pic18.h"
+
+#include <cstdint>
+
+/* =======================================
+ *        74HC595 CHAIN MODEL
+ * ======================================= */
+/*
+ * Shift registers daisy-chained QH' -> SER, wired as the TLight.c
+ * LED_BACKEND_595 backend: SER RD1, SRCLK RD2, RCLK RD3 (/OE low, /SRCLR
+ * high). SER is sampled on each SRCLK rising edge, the outputs load the
+ * shift register on each RCLK rising edge. Output 0 is QA of the first chip
+ * (the one SER feeds), so the bit shifted in first ends on the last output.
+ *
+ * Built with SIM_HC595 (make LED_BACKEND=595), SimMain and Soak wire one in:
+ * ledOutputs() then reads the first six outputs.
+ */
+
+namespace sim
+{
+    class Hc595Chain : public Peripheral
+    {
+    public:
+        Hc595Chain(Pic18 &mcu, int size);
+        ~Hc595Chain() override;
+
+        // The chain on the board (the last one created), nullptr without one
+        static Hc595Chain *current() { return current_; }
+
+        int size() const { return size_; }
+        uint64_t outputs() const { return outputs_; } // Bit n = output n
+        uint64_t latches() const { return latches_; }
+
+        // ---------- Peripheral ----------
+        void onPinsChanged(Pic18 &mcu, int port) override;
+
+    private:
+        static Hc595Chain *current_;
+
+        int size_;
+        uint64_t shift_;
+        uint64_t outputs_;
+        bool clock_;
+        bool latch_;
+        uint64_t latches_;
+    };
+}
+
+#endif
@@ -0,0 +1,299 @@
+#include "Hd44780.h"
+
+#include <algorithm>
+
+namespace sim
+{
+    /* =======================================
+     *              CONSTANTS
+     * ======================================= */
+
+    // Pins (TLCD.c)
+    constexpr uint8_t kRsPin = 0x20;   // RD5
+    constexpr uint8_t kRwPin = 0x40;   // RD6
+    constexpr uint8_t kEPin = 0x80;    // RD7
+    constexpr uint8_t kDataPins = 0x0F; // RB0-RB3 = D4-D7
+
+    // Instructions
+    constexpr uint8_t kClear = 0x01, kHome = 0x02, kEntryMode = 0x04, kDisplayControl = 0x08;
+    constexpr uint8_t kShift = 0x10, kFunctionSet = 0x20, kSetCgram = 0x40, kSetDdram = 0x80;
+    constexpr uint8_t kIncrement = 0x02, kEntryShift = 0x01;
+    constexpr uint8_t kShiftDisplay = 0x08, kShiftRight = 0x04;
+    constexpr uint8_t kEightBit = 0x10, kTwoLines = 0x08;
+    constexpr uint8_t kBusyFlag = 0x80;
+
+    // Timing
+    constexpr uint64_t kPowerOnBusy = msToCycles(10);
+    constexpr uint64_t kLongExecution = usToCycles(1520); // Clear display, return home
+    constexpr uint64_t kExecution = usToCycles(37);
+    constexpr double kMinPulseUs = 0.230; // PWEH
+
+    constexpr int kLineLength = 40;
+    constexpr uint8_t kLine2 = 0x40;
+    constexpr uint8_t kLine1End = 0x27, kLine2End = 0x67, kOneLineEnd = 0x4F;
+
+    /* =======================================
+     *              LIFECYCLE
+     * ======================================= */
+
+    Hd44780::Hd44780(Pic18 &mcu)
+        : mcu_(mcu), rs_(false), rw_(false), e_(false), data_(0), eRiseCycle_(0),
+          fourBit_(false), lowNibble_(false), pending_(0), readLatch_(0),
+          busyUntil_(mcu.cycle() + kPowerOnBusy),
+          ac_(0), acInCgram_(false), twoLines_(false), entryMode_(kIncrement), displayControl_(0), shift_(0),
+          enablePulses_(0), instructions_(0), dataWrites_(0), busyReads_(0), busyReadsWhileBusy_(0),
+          writesWhileBusy_(0), shortPulses_(0)
+    {
+        // Initialization by the internal reset circuit: 8-bit, 1 line, display off, cleared
+        std::fill(ddram_, ddram_ + sizeof(ddram_), ' ');
+        std::fill(cgram_, cgram_ + sizeof(cgram_), 0);
+        mcu.attach(this);
+    }
+
+    /* =======================================
+     *                PINS
+     * ======================================= */
+
+    void Hd44780::onPinsChanged(Pic18 &mcu, int port)
+    {
+        if (port == PortB)
+        {
+            data_ = mcu.outputs(PortB) & kDataPins;
+            return;
+        }
+        if (port != PortD)
+            return;
+
+        uint8_t levels = mcu.outputs(PortD);
+        rs_ = (levels & kRsPin) != 0;
+        rw_ = (levels & kRwPin) != 0;
+        bool e = (levels & kEPin) != 0;
+        if (e == e_)
+            return;
+        e_ = e;
+        if (e)
+            enableRising();
+        else
+            enableFalling();
+    }
+
+    void Hd44780::driveInputs(Pic18 &mcu, int port, uint8_t &levels)
+    {
+        if (port != PortB || !e_ || !rw_)
+            return;
+        uint8_t nibble = (fourBit_ && lowNibble_) ? (readLatch_ & 0x0F) : (readLatch_ >> 4);
+        levels |= nibble;
+    }
+
+    void Hd44780::enableRising()
+    {
+        eRiseCycle_ = mcu_.cycle();
+        if (!rw_ || (fourBit_ && lowNibble_))
+            return;
+
+        // First transfer of a read: sample what the controller outputs
+        readLatch_ = readByte();
+    }
+
+    void Hd44780::enableFalling()
+    {
+        enablePulses_++;
+        if (cyclesToUs(mcu_.cycle() - eRiseCycle_) < kMinPulseUs)
+            shortPulses_++;
+
+        if (rw_)
+        {
+            bool done = !fourBit_ || lowNibble_;
+            if (fourBit_)
+                lowNibble_ = !lowNibble_;
+            if (done && rs_)
+                moveAddress((entryMode_ & kIncrement) != 0); // Data read advances the counter
+            return;
+        }
+
+        if (!fourBit_)
+        {
+            execute((uint8_t)(data_ << 4));
+        }
+        else if (!lowNibble_)
+        {
+            pending_ = (uint8_t)(data_ << 4);
+            lowNibble_ = true;
+        }
+        else
+        {
+            lowNibble_ = false;
+            execute(pending_ | data_);
+        }
+    }
+
+    /* =======================================
+     *              CONTROLLER
+     * ======================================= */
+
+    uint8_t Hd44780::readByte()
+    {
+        if (rs_)
+            return acInCgram_ ? cgram_[ac_ & 0x3F] : ddram_[ddramIndex(ac_)];
+
+        busyReads_++;
+        if (busy())
+        {
+            busyReadsWhileBusy_++;
+            return kBusyFlag | ac_;
+        }
+        return ac_;
+    }
+
+    void Hd44780::execute(uint8_t value)
+    {
+        if (busy())
+            writesWhileBusy_++; // Undefined on the real part: applied anyway, but reported
+        if (rs_)
+            writeData(value);
+        else
+            instruction(value);
+    }
+
+    void Hd44780::instruction(uint8_t value)
+    {
+        instructions_++;
+        uint64_t duration = kExecution;
+
+        if (value & kSetDdram)
+        {
+            ac_ = value & 0x7F;
+            acInCgram_ = false;
+        }
+        else if (value & kSetCgram)
+        {
+            ac_ = value & 0x3F;
+            acInCgram_ = true;
+        }
+        else if (value & kFunctionSet)
+        {
+            fourBit_ = !(value & kEightBit);
+            twoLines_ = (value & kTwoLines) != 0;
+            lowNibble_ = false;
+        }
+        else if (value & kShift)
+        {
+            bool right = (value & kShiftRight) != 0;
+            if (value & kShiftDisplay)
+                shift_ += right ? -1 : 1;
+            else
+                moveAddress(right);
+        }
+        else if (value & kDisplayControl)
+        {
+            bool wasOn = displayOn();
+            displayControl_ = value & 0x07;
+            if (displayOn() != wasOn)
+                changed();
+        }
+        else if (value & kEntryMode)
+        {
+            entryMode_ = value & 0x03;
+        }
+        else if (value & kHome)
+        {
+            ac_ = 0;
+            acInCgram_ = false;
+            shift_ = 0;
+            duration = kLongExecution;
+        }
+        else if (value & kClear)
+        {
+            if (std::count(ddram_, ddram_ + sizeof(ddram_), ' ') != (long)sizeof(ddram_))
+                changed();
+            std::fill(ddram_, ddram_ + sizeof(ddram_), ' ');
+            ac_ = 0;
+            acInCgram_ = false;
+            shift_ = 0;
+            entryMode_ |= kIncrement;
+            duration = kLongExecution;
+        }
+        busyUntil_ = mcu_.cycle() + duration;
+    }
+
+    void Hd44780::writeData(uint8_t value)
+    {
+        dataWrites_++;
+        bool increment = (entryMode_ & kIncrement) != 0;
+        if (acInCgram_)
+        {
+            cgram_[ac_ & 0x3F] = value;
+        }
+        else
+        {
+            uint8_t &cell = ddram_[ddramIndex(ac_)];
+            if (cell != value)
+            {
+                cell = value;
+                changed();
+            }
+            if (entryMode_ & kEntryShift)
+                shift_ += increment ? 1 : -1;
+        }
+        moveAddress(increment);
+        busyUntil_ = mcu_.cycle() + kExecution;
+    }
+
+    void Hd44780::moveAddress(bool increment)
+    {
+        if (acInCgram_)
+        {
+            ac_ = (ac_ + (increment ? 1 : -1)) & 0x3F;
+        }
+        else if (twoLines_)
+        {
+            if (increment)
+                ac_ = ac_ == kLine1End ? kLine2 : ac_ == kLine2End ? 0 : ac_ + 1;
+            else
+                ac_ = ac_ == 0 ? kLine2End : ac_ == kLine2 ? kLine1End : ac_ - 1;
+        }
+        else
+        {
+            if (increment)
+                ac_ = ac_ >= kOneLineEnd ? 0 : ac_ + 1;
+            else
+                ac_ = ac_ == 0 ? kOneLineEnd : ac_ - 1;
+        }
+    }
+
+    int Hd44780::ddramIndex(uint8_t address) const
+    {
+        if (!twoLines_)
+            return address % (2 * kLineLength);
+        if (address >= kLine2)
+            return kLineLength + (address - kLine2) % kLineLength;
+        return address % kLineLength;
+    }
+
+    void Hd44780::changed()
+    {
+        for (auto &listener : listeners_)
+            listener();
+    }
+
+    std::string Hd44780::line(int row) const
+    {
+        std::string text;
+        for (int column = 0; column < kColumns; column++)
+        {
+            char c = ' ';
+            if (twoLines_)
+            {
+                int offset = ((column + shift_) % kLineLength + kLineLength) % kLineLength;
+                c = (char)ddram_[row * kLineLength + offset];
+            }
+            else if (row == 0)
+            {
+                int offset = ((column + shift_) % (2 * kLineLength) + 2 * kLineLength) % (2 * kLineLength);
+                c = (char)ddram_[offset];
+            }
+            text += (c >= 0x20 && c < 0x7F) ? c : '?';
+        }
+        return text;
+    }
+}
@@ -0,0 +1,114 @@
+#ifndef SIM_HD44780_H
+#define SIM_HD44780_H
+
+#include "Pic18.h"
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+/* =======================================
+ *     HD44780 2x16 LCD CONTROLLER MODEL
+ * ======================================= */
+/*
+ * Wired as in TLCD.c: RS = RD5, RW = RD6, E = RD7, D4-D7 = RB0-RB3 (D0-D3
+ * not connected, read as 0 while the interface is still 8-bit).
+ *
+ * - Writes are latched on the E falling edge. In 4-bit mode the high nibble
+ *   comes first and the byte runs when the low nibble arrives
+ * - Reads drive D4-D7 while E is high: busy flag + address counter (RS = 0)
+ *   or DDRAM data (RS = 1), high nibble first
+ * - Instruction set: clear, home, entry mode, display control, cursor/display
+ *   shift, function set (DL/N), CGRAM/DDRAM address
+ * - DDRAM: 2 x 40 bytes at 0x00-0x27 and 0x40-0x67, address counter wraps
+ *   between the lines; the visible window follows the display shift
+ *
+ * TIMING (datasheet, fosc = 270 kHz):
+ * - Busy for 10 ms after power-on (internal reset)
+ * - Clear display and return home: 1.52 ms, everything else: 37 us
+ * - Every byte written while the busy flag is set and every E pulse shorter
+ *   than PWEH (230 ns) is counted as a protocol violation
+ */
+
+namespace sim
+{
+    class Hd44780 : public Peripheral
+    {
+    public:
+        static constexpr int kRows = 2;
+        static constexpr int kColumns = 16;
+
+        explicit Hd44780(Pic18 &mcu);
+
+        // ---------- Display ----------
+        std::string line(int row) const; // Visible characters, even with the display off
+        bool displayOn() const { return (displayControl_ & 0x04) != 0; }
+        uint8_t addressCounter() const { return ac_; }
+        bool busy() const { return mcu_.cycle() < busyUntil_; }
+
+        // ---------- Observation ----------
+        uint64_t enablePulses() const { return enablePulses_; }
+        uint64_t instructions() const { return instructions_; }
+        uint64_t dataWrites() const { return dataWrites_; }
+        uint64_t busyReads() const { return busyReads_; }
+        uint64_t busyReadsWhileBusy() const { return busyReadsWhileBusy_; }
+        uint64_t writesWhileBusy() const { return writesWhileBusy_; }
+        uint64_t shortPulses() const { return shortPulses_; }
+
+        // Called whenever a DDRAM cell gets a different character or the display is switched on/off
+        void onChange(std::function<void()> listener) { listeners_.push_back(listener); }
+
+        // ---------- Peripheral ----------
+        void onPinsChanged(Pic18 &mcu, int port) override;
+        void driveInputs(Pic18 &mcu, int port, uint8_t &levels) override;
+
+    private:
+        void enableRising();
+        void enableFalling();
+        void execute(uint8_t value);
+        void instruction(uint8_t value);
+        void writeData(uint8_t value);
+        uint8_t readByte();
+        void moveAddress(bool increment);
+        int ddramIndex(uint8_t address) const;
+        void changed();
+
+        Pic18 &mcu_;
+
+        // Pins
+        bool rs_;
+        bool rw_;
+        bool e_;
+        uint8_t data_; // D7-D4 as driven by the PIC
+        uint64_t eRiseCycle_;
+
+        // Interface
+        bool fourBit_;
+        bool lowNibble_; // 4-bit mode: next transfer is the low nibble
+        uint8_t pending_;
+        uint8_t readLatch_; // Byte being read, sampled on the first read pulse
+        uint64_t busyUntil_;
+
+        // Controller
+        uint8_t ddram_[80];
+        uint8_t cgram_[64];
+        uint8_t ac_;
+        bool acInCgram_;
+        bool twoLines_;
+        uint8_t entryMode_;
+        uint8_t displayControl_;
+        int shift_;
+
+        uint64_t enablePulses_;
+        uint64_t instructions_;
+        uint64_t dataWrites_;
+        uint64_t busyReads_;
+        uint64_t busyReadsWhileBusy_;
+        uint64_t writesWhileBusy_;
+        uint64_t shortPulses_;
+        std::vector<std::function<void()>> listeners_;
+    };
+}
+
+#endif
@@ -0,0 +1,72 @@
+#include "Keypad.h"
+
+#include <cstring>
+
+namespace sim
+{
+    /* =======================================
+     *              CONSTANTS
+     * ======================================= */
+
+    constexpr int kRows = 4;
+    constexpr int kColumns = 3;
+    constexpr char kLayout[] = "123456789*0#"; // Row by row
+    constexpr uint8_t kColumnPins[kColumns] = {0x04, 0x01, 0x10}; // RA2, RA0, RA4
+    constexpr uint8_t kRowPins[kRows] = {0x02, 0x40, 0x20, 0x08};  // RA1, RA6, RA5, RA3
+
+    /* =======================================
+     *               KEYPAD
+     * ======================================= */
+
+    KeypadMatrix::KeypadMatrix(Pic18 &mcu)
+        : mcu_(mcu), pressed_(0)
+    {
+        mcu.attach(this);
+    }
+
+    int KeypadMatrix::keyIndex(char key)
+    {
+        const char *position = key ? std::strchr(kLayout, key) : nullptr;
+        return position ? (int)(position - kLayout) : -1;
+    }
+
+    bool KeypadMatrix::isKey(char key)
+    {
+        return keyIndex(key) >= 0;
+    }
+
+    void KeypadMatrix::press(char key)
+    {
+        int index = keyIndex(key);
+        if (index >= 0)
+            pressed_ |= 1u << index;
+    }
+
+    void KeypadMatrix::release(char key)
+    {
+        int index = keyIndex(key);
+        if (index >= 0)
+            pressed_ &= ~(1u << index);
+    }
+
+    void KeypadMatrix::schedulePress(char key, uint64_t cycle, uint64_t holdCycles)
+    {
+        mcu_.at(cycle, [this, key]
+                { press(key); });
+        mcu_.at(cycle + holdCycles, [this, key]
+                { release(key); });
+    }
+
+    void KeypadMatrix::driveInputs(Pic18 &mcu, int port, uint8_t &levels)
+    {
+        if (port != PortA || pressed_ == 0)
+            return;
+
+        uint8_t driven = mcu.outputs(PortA);
+        for (int index = 0; index < kRows * kColumns; index++)
+        {
+            if ((pressed_ & (1u << index)) && (driven & kColumnPins[index % kColumns]))
+                levels |= kRowPins[index / kColumns];
+        }
+    }
+}
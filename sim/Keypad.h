@@ -0,0 +1,49 @@
+#ifndef SIM_KEYPAD_H
+#define SIM_KEYPAD_H
+
+#include "Pic18.h"
+
+#include <cstdint>
+
+/* =======================================
+ *         3x4 KEYPAD MATRIX MODEL
+ * ======================================= */
+/*
+ * Wired as in TKeypad.c: columns RA2, RA0, RA4 are driven by the PIC, rows
+ * RA1, RA6, RA5, RA3 read high while a pressed key connects them to a column
+ * that is driven high (rows are pulled down).
+ *
+ *     1 2 3
+ *     4 5 6
+ *     7 8 9
+ *     * 0 #
+ *
+ * Contacts are ideal (no bounce): the firmware's debounce only adds its
+ * sampling delay.
+ */
+
+namespace sim
+{
+    class KeypadMatrix : public Peripheral
+    {
+    public:
+        explicit KeypadMatrix(Pic18 &mcu);
+
+        static bool isKey(char key);
+        void press(char key);
+        void release(char key);
+
+        // Press 'key' at 'cycle' and release it 'holdCycles' later
+        void schedulePress(char key, uint64_t cycle, uint64_t holdCycles);
+
+        void driveInputs(Pic18 &mcu, int port, uint8_t &levels) override;
+
+    private:
+        static int keyIndex(char key);
+
+        Pic18 &mcu_;
+        uint16_t pressed_; // Bit (row * 3 + column) per key
+    };
+}
+
+#endif
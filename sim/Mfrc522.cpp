@@ -0,0 +1,613 @@
+#include "Mfrc522.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+
+namespace sim
+{
+    /* =======================================
+     *              CONSTANTS
+     * ======================================= */
+
+    // Pins (TRFID.h)
+    constexpr uint8_t kCsPin = 0x01;   // RC0
+    constexpr uint8_t kSckPin = 0x10;  // RC4
+    constexpr uint8_t kMosiPin = 0x20; // RC5
+    constexpr uint8_t kMisoPin = 0x08; // RC3
+    constexpr uint8_t kRstPin = 0x01;  // RD0
+
+    // Registers
+    enum Reg : uint8_t
+    {
+        kCommandReg = 0x01,
+        kComIEnReg = 0x02,
+        kDivIEnReg = 0x03,
+        kComIrqReg = 0x04,
+        kDivIrqReg = 0x05,
+        kErrorReg = 0x06,
+        kStatus1Reg = 0x07,
+        kStatus2Reg = 0x08,
+        kFIFODataReg = 0x09,
+        kFIFOLevelReg = 0x0A,
+        kWaterLevelReg = 0x0B,
+        kControlReg = 0x0C,
+        kBitFramingReg = 0x0D,
+        kCollReg = 0x0E,
+        kModeReg = 0x11,
+        kTxControlReg = 0x14,
+        kCRCResultRegH = 0x21,
+        kCRCResultRegL = 0x22,
+        kTModeReg = 0x2A,
+        kTPrescalerReg = 0x2B,
+        kTReloadRegH = 0x2C,
+        kTReloadRegL = 0x2D,
+        kVersionReg = 0x37
+    };
+
+    // Commands
+    constexpr uint8_t kIdle = 0x00, kCalcCRC = 0x03, kTransceive = 0x0C, kSoftReset = 0x0F;
+    constexpr uint8_t kCommandMask = 0x0F;
+
+    // Bits
+    constexpr uint8_t kSet = 0x80;
+    constexpr uint8_t kTxIRq = 0x40, kRxIRq = 0x20, kIdleIRq = 0x10, kLoAlertIRq = 0x04, kErrIRq = 0x02, kTimerIRq = 0x01;
+    constexpr uint8_t kCRCIRq = 0x04, kDivIrqMask = 0x14;
+    constexpr uint8_t kCollErr = 0x08, kBufferOvfl = 0x10;
+    constexpr uint8_t kFlushBuffer = 0x80;
+    constexpr uint8_t kTStopNow = 0x80, kTStartNow = 0x40, kRxLastBits = 0x07;
+    constexpr uint8_t kStartSend = 0x80, kTxLastBits = 0x07;
+    constexpr uint8_t kTAuto = 0x80;
+    constexpr uint8_t kAntennaMask = 0x03;
+    constexpr uint8_t kCRCPreset = 0x03;
+
+    constexpr size_t kFifoSize = 64;
+    constexpr uint8_t kVersion = 0x92;
+
+    // PICC commands
+    constexpr uint8_t kREQA = 0x26, kWUPA = 0x52, kSEL1 = 0x93, kHLTA = 0x50;
+    constexpr uint8_t kNVBAnticoll = 0x20, kNVBSelect = 0x70;
+    constexpr uint8_t kATQA[2] = {0x04, 0x00}; // Single size UID
+    constexpr uint8_t kSAK = 0x08;             // MIFARE Classic 1K
+
+    // RF timing (ISO 14443-2, 106 kbit/s)
+    constexpr double kCarrier = 13.56e6;
+    constexpr double kBitPeriods = 128.0;
+    constexpr double kFdtPeriods = 1172.0;
+    constexpr unsigned kFrameOverheadBits = 2; // SOF + EOF
+
+    uint32_t uidKey(const Mfrc522::Card &card)
+    {
+        return ((uint32_t)card.uid[0] << 24) | ((uint32_t)card.uid[1] << 16) | ((uint32_t)card.uid[2] << 8) | card.uid[3];
+    }
+
+    /* =======================================
+     *              LIFECYCLE
+     * ======================================= */
+
+    Mfrc522::Mfrc522(Pic18 &mcu)
+        : mcu_(mcu), cs_(true), sck_(false), mosi_(false), miso_(false), rst_(false),
+          shiftIn_(0), shiftOut_(0), bitCount_(0), haveAddress_(false), readFrame_(false), address_(0),
+          transmitting_(false), generation_(0), timerGeneration_(0),
+          uidBytesLeft_(0), uidFrom_(0),
+          sckEdges_(0), transactions_(0), framesSent_(0), uidReads_(0)
+    {
+        resetChip();
+        mcu.attach(this);
+    }
+
+    void Mfrc522::resetChip()
+    {
+        std::fill(regs_, regs_ + sizeof(regs_), 0);
+        regs_[kCommandReg] = 0x20;
+        regs_[kComIEnReg] = 0x80;
+        regs_[kComIrqReg] = 0x14;
+        regs_[kStatus1Reg] = 0x21;
+        regs_[kWaterLevelReg] = 0x08;
+        regs_[kControlReg] = 0x10;
+        regs_[kCollReg] = 0x80;
+        regs_[kModeReg] = 0x3F;
+        regs_[kTxControlReg] = 0x80; // Antenna off
+        regs_[kCRCResultRegH] = 0xFF;
+        regs_[kCRCResultRegL] = 0xFF;
+        regs_[kVersionReg] = kVersion;
+        fifo_.clear();
+        uidBytesLeft_ = 0;
+        transmitting_ = false;
+        generation_++;
+        timerGeneration_++;
+        powerCards();
+    }
+
+    /* =======================================
+     *                 SPI
+     * ======================================= */
+
+    void Mfrc522::onPinsChanged(Pic18 &mcu, int port)
+    {
+        if (port == PortD)
+        {
+            bool rst = (mcu.outputs(PortD) & kRstPin) != 0;
+            if (rst && !rst_)
+                resetChip(); // Leaving hard power-down
+            rst_ = rst;
+            return;
+        }
+        if (port != PortC)
+            return;
+
+        uint8_t levels = mcu.outputs(PortC);
+        bool cs = (levels & kCsPin) != 0;
+        bool sck = (levels & kSckPin) != 0;
+        mosi_ = (levels & kMosiPin) != 0;
+
+        if (cs != cs_)
+        {
+            cs_ = cs;
+            bitCount_ = 0;
+            haveAddress_ = false;
+            miso_ = false;
+        }
+        if (sck != sck_)
+        {
+            sck_ = sck;
+            if (!cs_ && rst_)
+            {
+                sckEdges_++;
+                clockEdge(sck);
+            }
+        }
+    }
+
+    void Mfrc522::driveInputs(Pic18 &mcu, int port, uint8_t &levels)
+    {
+        if (port == PortC && !cs_ && rst_ && miso_)
+            levels |= kMisoPin;
+    }
+
+    void Mfrc522::clockEdge(bool rising)
+    {
+        if (!rising)
+        {
+            // Mode 0: the next bit is presented after the falling edge
+            if (haveAddress_ && readFrame_)
+            {
+                miso_ = (shiftOut_ & 0x80) != 0;
+                shiftOut_ <<= 1;
+            }
+            return;
+        }
+
+        shiftIn_ = (uint8_t)((shiftIn_ << 1) | (mosi_ ? 1 : 0));
+        if (++bitCount_ < 8)
+            return;
+        bitCount_ = 0;
+
+        if (!haveAddress_)
+        {
+            haveAddress_ = true;
+            readFrame_ = (shiftIn_ & 0x80) != 0;
+            address_ = (shiftIn_ >> 1) & 0x3F;
+            transactions_++;
+            if (readFrame_)
+            {
+                shiftOut_ = readRegister(address_);
+                registerAccessed(true, shiftOut_);
+            }
+        }
+        else if (readFrame_)
+        {
+            // Multi-byte read: the byte clocked in is the next address (0x00 ends it)
+            address_ = (shiftIn_ >> 1) & 0x3F;
+            shiftOut_ = readRegister(address_);
+            registerAccessed(true, shiftOut_);
+        }
+        else
+        {
+            writeRegister(address_, shiftIn_);
+            registerAccessed(false, shiftIn_);
+        }
+    }
+
+    void Mfrc522::registerAccessed(bool read, uint8_t value)
+    {
+        for (auto &listener : registerListeners_)
+            listener(address_, read, value);
+    }
+
+    /* =======================================
+     *            REGISTER FILE
+     * ======================================= */
+
+    uint8_t Mfrc522::readRegister(uint8_t address)
+    {
+        switch (address)
+        {
+        case kFIFODataReg:
+        {
+            if (fifo_.empty())
+                return 0;
+            uint8_t value = fifo_.front();
+            fifo_.pop_front();
+            if (uidBytesLeft_ > 0 && --uidBytesLeft_ == 0)
+                uidRead();
+            return value;
+        }
+        case kFIFOLevelReg:
+            return (uint8_t)fifo_.size();
+        default:
+            return regs_[address];
+        }
+    }
+
+    void Mfrc522::writeRegister(uint8_t address, uint8_t value)
+    {
+        uint8_t &reg = regs_[address];
+        switch (address)
+        {
+        case kCommandReg:
+            reg = (reg & ~kCommandMask) | (value & 0x30);
+            startCommand(value & kCommandMask);
+            break;
+        case kComIrqReg:
+            if (value & kSet)
+                reg |= value & 0x7F;
+            else
+                reg &= ~(value & 0x7F);
+            break;
+        case kDivIrqReg:
+            if (value & kSet)
+                reg |= value & kDivIrqMask;
+            else
+                reg &= ~(value & kDivIrqMask);
+            break;
+        case kErrorReg:
+        case kStatus1Reg:
+        case kCollReg:
+        case kCRCResultRegH:
+        case kCRCResultRegL:
+        case kVersionReg:
+            break; // Read-only
+        case kStatus2Reg:
+            reg = (value & 0xC8) | (reg & 0x07);
+            break;
+        case kFIFODataReg:
+            pushFifo(value);
+            break;
+        case kFIFOLevelReg:
+            if (value & kFlushBuffer)
+            {
+                fifo_.clear();
+                uidBytesLeft_ = 0;
+                regs_[kErrorReg] &= ~kBufferOvfl;
+            }
+            break;
+        case kControlReg:
+            if (value & kTStopNow)
+                timerGeneration_++;
+            else if (value & kTStartNow)
+                startTimer();
+            break;
+        case kBitFramingReg:
+        {
+            bool wasSending = (reg & kStartSend) != 0;
+            reg = value;
+            if ((value & kStartSend) && !wasSending && (regs_[kCommandReg] & kCommandMask) == kTransceive)
+                startTransmit();
+            break;
+        }
+        case kTxControlReg:
+        {
+            bool wasOn = antennaOn();
+            reg = value;
+            if (antennaOn() != wasOn)
+                powerCards();
+            break;
+        }
+        default:
+            reg = value;
+            break;
+        }
+    }
+
+    void Mfrc522::pushFifo(uint8_t value)
+    {
+        if (fifo_.size() >= kFifoSize)
+        {
+            regs_[kErrorReg] |= kBufferOvfl;
+            setIrq(kComIrqReg, kErrIRq);
+            return;
+        }
+        fifo_.push_back(value);
+    }
+
+    void Mfrc522::setIrq(uint8_t address, uint8_t mask)
+    {
+        regs_[address] |= mask;
+    }
+
+    /* =======================================
+     *              COMMANDS
+     * ======================================= */
+
+    void Mfrc522::startCommand(uint8_t command)
+    {
+        // A new command cancels whatever the previous one had in flight
+        generation_++;
+        transmitting_ = false;
+        regs_[kCommandReg] = (regs_[kCommandReg] & ~kCommandMask) | command;
+
+        switch (command)
+        {
+        case kIdle:
+            break; // Started by the host: no IdleIRq
+        case kCalcCRC:
+            calculateCrc();
+            break;
+        case kTransceive:
+            if (regs_[kBitFramingReg] & kStartSend)
+                startTransmit();
+            break;
+        case kSoftReset:
+            resetChip();
+            break;
+        default:
+            // Mem, Transmit, Receive, MFAuthent... are not modelled: end at once
+            regs_[kCommandReg] &= ~kCommandMask;
+            setIrq(kComIrqReg, kIdleIRq);
+            break;
+        }
+    }
+
+    void Mfrc522::calculateCrc()
+    {
+        std::vector<uint8_t> data(fifo_.begin(), fifo_.end());
+        fifo_.clear();
+        uint16_t crc = crcA(data.data(), data.size(), regs_[kModeReg] & kCRCPreset);
+        regs_[kCRCResultRegH] = crc >> 8;
+        regs_[kCRCResultRegL] = crc & 0xFF;
+        setIrq(kDivIrqReg, kCRCIRq); // The command stays active until the host writes Idle
+    }
+
+    void Mfrc522::startTransmit()
+    {
+        if (transmitting_)
+            return;
+        transmitting_ = true;
+        regs_[kErrorReg] &= ~(kCollErr | 0x07);
+        regs_[kCollReg] = 0x80;
+
+        std::vector<uint8_t> frame(fifo_.begin(), fifo_.end());
+        fifo_.clear();
+        uidBytesLeft_ = 0;
+        unsigned lastBits = regs_[kBitFramingReg] & kTxLastBits;
+        framesSent_++;
+
+        // Full bytes carry a parity bit; a short frame (REQA/WUPA) does not
+        unsigned bits = kFrameOverheadBits;
+        if (!frame.empty())
+            bits += (unsigned)(frame.size() - 1) * 9 + (lastBits ? lastBits : 9);
+
+        unsigned generation = generation_;
+        mcu_.at(mcu_.cycle() + rfCycles(bits * kBitPeriods), [this, generation, frame, lastBits]
+                { finishTransmit(generation, frame, lastBits); });
+    }
+
+    void Mfrc522::finishTransmit(unsigned generation, const std::vector<uint8_t> &frame, unsigned lastBits)
+    {
+        if (generation != generation_)
+            return;
+        transmitting_ = false;
+        setIrq(kComIrqReg, kTxIRq | (fifo_.size() <= regs_[kWaterLevelReg] ? kLoAlertIRq : 0));
+
+        uint64_t timeout = timerPeriod();
+        if (regs_[kTModeReg] & kTAuto)
+            startTimer();
+
+        Answer answer = cardsAnswer(frame, lastBits);
+        if (answer.bytes.empty())
+            return; // Only the timer can end the wait
+
+        uint64_t answerStart = rfCycles(kFdtPeriods);
+        if (!(regs_[kTModeReg] & kTAuto) || answerStart < timeout)
+            timerGeneration_++; // The first received bits stop the timer
+
+        unsigned bits = kFrameOverheadBits + (unsigned)answer.bytes.size() * 9;
+        mcu_.at(mcu_.cycle() + answerStart + rfCycles(bits * kBitPeriods), [this, generation, answer]
+                { finishReceive(generation, answer); });
+    }
+
+    void Mfrc522::finishReceive(unsigned generation, const Answer &answer)
+    {
+        if (generation != generation_)
+            return;
+        for (uint8_t value : answer.bytes)
+            pushFifo(value);
+        regs_[kControlReg] &= ~kRxLastBits; // Card answers are whole bytes
+        if (answer.collision)
+        {
+            regs_[kErrorReg] |= kCollErr;
+            regs_[kCollReg] &= ~0x20; // CollPosNotValid = 0
+            setIrq(kComIrqReg, kErrIRq);
+        }
+        if (answer.uidFrom != 0)
+        {
+            uidBytesLeft_ = (unsigned)answer.bytes.size();
+            uidFrom_ = answer.uidFrom;
+        }
+        setIrq(kComIrqReg, kRxIRq);
+    }
+
+    /* =======================================
+     *                TIMER
+     * ======================================= */
+
+    uint64_t Mfrc522::timerPeriod() const
+    {
+        unsigned prescaler = ((regs_[kTModeReg] & 0x0F) << 8) | regs_[kTPrescalerReg];
+        unsigned reload = (regs_[kTReloadRegH] << 8) | regs_[kTReloadRegL];
+        return rfCycles((double)(reload + 1) * (2.0 * prescaler + 1.0));
+    }
+
+    void Mfrc522::startTimer()
+    {
+        unsigned generation = ++timerGeneration_;
+        mcu_.at(mcu_.cycle() + timerPeriod(), [this, generation]
+                {
+            if (generation == timerGeneration_)
+                setIrq(kComIrqReg, kTimerIRq); });
+    }
+
+    /* =======================================
+     *           CARDS IN THE FIELD
+     * ======================================= */
+
+    bool Mfrc522::antennaOn() const
+    {
+        return (regs_[kTxControlReg] & kAntennaMask) != 0;
+    }
+
+    void Mfrc522::powerCards()
+    {
+        // Cards lose power with the field and come back in IDLE
+        for (FieldCard &card : field_)
+            card.state = CardIdle;
+    }
+
+    Mfrc522::Answer Mfrc522::cardsAnswer(const std::vector<uint8_t> &frame, unsigned lastBits)
+    {
+        Answer answer = {{}, false, 0};
+        if (!antennaOn() || frame.empty())
+            return answer;
+
+        bool request = frame.size() == 1 && lastBits == 7 && (frame[0] == kREQA || frame[0] == kWUPA);
+        bool anticoll = frame.size() == 2 && lastBits == 0 && frame[0] == kSEL1 && frame[1] == kNVBAnticoll;
+        bool select = frame.size() == 9 && lastBits == 0 && frame[0] == kSEL1 && frame[1] == kNVBSelect &&
+                      crcA(frame.data(), 7, 1) == (uint16_t)(frame[7] | (frame[8] << 8));
+        bool halt = frame.size() == 4 && lastBits == 0 && frame[0] == kHLTA && frame[1] == 0x00 &&
+                    crcA(frame.data(), 2, 1) == (uint16_t)(frame[2] | (frame[3] << 8));
+
+        for (FieldCard &card : field_)
+        {
+            const uint8_t *uid = card.card.uid;
+            uint8_t bcc = uid[0] ^ uid[1] ^ uid[2] ^ uid[3];
+
+            if (request && (card.state == CardIdle || (card.state == CardHalt && frame[0] == kWUPA)))
+            {
+                card.state = CardReady;
+                answer.bytes.assign(kATQA, kATQA + sizeof(kATQA)); // Same ATQA from every card: no collision
+            }
+            else if (anticoll && card.state == CardReady)
+            {
+                std::vector<uint8_t> bytes = {uid[0], uid[1], uid[2], uid[3], bcc};
+                if (answer.bytes.empty())
+                {
+                    answer.bytes = bytes;
+                    answer.uidFrom = uidKey(card.card);
+                }
+                else if (answer.bytes != bytes)
+                {
+                    answer.collision = true;
+                }
+            }
+            else if (select && card.state == CardReady && std::equal(uid, uid + 4, frame.begin() + 2) && frame[6] == bcc)
+            {
+                card.state = CardActive;
+                uint8_t sak[1] = {kSAK};
+                uint16_t crc = crcA(sak, 1, 1);
+                answer.bytes = {kSAK, (uint8_t)(crc & 0xFF), (uint8_t)(crc >> 8)};
+            }
+            else if (halt && card.state == CardActive)
+            {
+                card.state = CardHalt; // HLTA is never answered
+            }
+            else if (card.state == CardReady || card.state == CardActive)
+            {
+                card.state = CardIdle; // Unexpected frame (e.g. HLTA while only READY)
+            }
+        }
+        if (answer.collision)
+            answer.uidFrom = 0;
+        return answer;
+    }
+
+    void Mfrc522::scheduleCard(const Card &card, uint64_t enterCycle, uint64_t leaveCycle)
+    {
+        mcu_.at(enterCycle, [this, card]
+                { enterField(card); });
+        if (leaveCycle > enterCycle)
+        {
+            mcu_.at(leaveCycle, [this, card]
+                    { leaveField(card); });
+        }
+    }
+
+    void Mfrc522::enterField(const Card &card)
+    {
+        FieldCard entry = {card, CardIdle, mcu_.cycle(), sckEdges_, transactions_, false};
+        field_.push_back(entry);
+    }
+
+    void Mfrc522::leaveField(const Card &card)
+    {
+        uint32_t key = uidKey(card);
+        field_.erase(std::remove_if(field_.begin(), field_.end(), [key](const FieldCard &entry)
+                                    { return uidKey(entry.card) == key; }),
+                     field_.end());
+    }
+
+    void Mfrc522::uidRead()
+    {
+        // The firmware has drained the whole ANTICOLL answer from the FIFO
+        uidReads_++;
+        for (FieldCard &card : field_)
+        {
+            if (uidKey(card.card) != uidFrom_ || card.reported)
+                continue;
+            card.reported = true;
+            Detection detection = {card.card, card.enterCycle, mcu_.cycle(),
+                                   sckEdges_ - card.sckEdgesAtEnter, transactions_ - card.transactionsAtEnter};
+            detections_.push_back(detection);
+            for (auto &listener : listeners_)
+                listener(detection);
+        }
+    }
+
+    bool Mfrc522::parseUid(const std::string &hex, Card &card)
+    {
+        if (hex.size() != 8)
+            return false;
+        for (int i = 0; i < 4; i++)
+        {
+            char *end = nullptr;
+            std::string digits = hex.substr(i * 2, 2);
+            long value = std::strtol(digits.c_str(), &end, 16);
+            if (*end != '\0')
+                return false;
+            card.uid[i] = (uint8_t)value;
+        }
+        return true;
+    }
+
+    /* =======================================
+     *               HELPERS
+     * ======================================= */
+
+    uint16_t Mfrc522::crcA(const uint8_t *data, size_t length, uint8_t preset)
+    {
+        static const uint16_t presets[4] = {0x0000, 0x6363, 0xA671, 0xFFFF};
+        uint16_t crc = presets[preset & kCRCPreset];
+        for (size_t i = 0; i < length; i++)
+        {
+            uint8_t value = data[i] ^ (uint8_t)(crc & 0xFF);
+            value ^= (uint8_t)(value << 4);
+            crc = (crc >> 8) ^ ((uint16_t)value << 8) ^ ((uint16_t)value << 3) ^ (value >> 4);
+        }
+        return crc;
+    }
+
+    uint64_t Mfrc522::rfCycles(double carrierPeriods)
+    {
+        return (uint64_t)std::llround(carrierPeriods * (double)kFcy / kCarrier);
+    }
+}
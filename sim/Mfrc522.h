@@ -0,0 +1,180 @@
+#ifndef SIM_MFRC522_H
+#define SIM_MFRC522_H
+
+#include "Pic18.h"
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <string>
+#include <vector>
+
+/* =======================================
+ *       MFRC522 (RC522) READER MODEL
+ * ======================================= */
+/*
+ * SPI slave wired as in TRFID.h: CS = RC0, SCK = RC4, MOSI = RC5, MISO = RC3,
+ * RST = RD0. Mode 0: MOSI is sampled on the SCK rising edge and MISO shifts
+ * on the falling edge. A frame is one address byte (bit 7 = read, bits 6-1 =
+ * register) followed by data bytes, until CS goes high.
+ *
+ * Register file:
+ * - CommandReg: Idle, CalcCRC, Transceive, SoftReset. Transceive starts
+ *   sending the FIFO when BitFramingReg.StartSend is set
+ * - ComIrqReg/DivIrqReg with the Set1/Set2 write semantics (bit 7 chooses
+ *   whether the marked bits are set or cleared)
+ * - ErrorReg (CollErr, BufferOvfl), cleared when a transmission starts
+ * - 64-byte FIFO, FIFOLevelReg.FlushBuffer, ControlReg.RxLastBits
+ * - Timer (TModeReg/TPrescalerReg/TReloadReg) started at the end of the
+ *   transmission when TAuto is set, raising TimerIRq if no answer comes
+ * - CRC_A coprocessor (CRCResultReg), TxControlReg antenna enable
+ *
+ * Virtual cards (ISO 14443-3 type A, 4-byte UID) follow IDLE/READY/ACTIVE/
+ * HALT: REQA/WUPA -> ATQA, ANTICOLL -> UID + BCC, SELECT -> SAK, HLTA.
+ * Any other command while READY or ACTIVE sends the card back to IDLE.
+ * Several READY cards answering ANTICOLL with different UIDs raise CollErr.
+ *
+ * RF timing at 106 kbit/s: 128/fc per bit, 9 bits per byte (parity), plus
+ * SOF/EOF, and 1172/fc between the reader frame and the card answer.
+ */
+
+namespace sim
+{
+    class Mfrc522 : public Peripheral
+    {
+    public:
+        struct Card
+        {
+            uint8_t uid[4];
+        };
+
+        // A card read by the firmware: tapped at 'enterCycle', UID drained
+        // from the FIFO at 'uidCycle'
+        struct Detection
+        {
+            Card card;
+            uint64_t enterCycle;
+            uint64_t uidCycle;
+            uint64_t sckEdges;     // SCK edges between the tap and the UID
+            uint64_t transactions; // Register accesses in the same window
+        };
+
+        explicit Mfrc522(Pic18 &mcu);
+
+        // ---------- Field script ----------
+        // The card enters the field at 'enterCycle' and leaves it at 'leaveCycle'
+        // (0 = never leaves)
+        void scheduleCard(const Card &card, uint64_t enterCycle, uint64_t leaveCycle = 0);
+        void leaveField(const Card &card);
+        static bool parseUid(const std::string &hex, Card &card);
+
+        // ---------- Observation ----------
+        uint64_t sckEdges() const { return sckEdges_; } // SCK transitions while CS is low
+        uint64_t transactions() const { return transactions_; }
+        uint64_t frames() const { return framesSent_; }
+        uint64_t uidReads() const { return uidReads_; }
+        const std::vector<Detection> &detections() const { return detections_; }
+        // Called the first time each card in the field has its UID read
+        void onDetection(std::function<void(const Detection &)> listener) { listeners_.push_back(listener); }
+        // Called for every register read or written over SPI, with the value read or written
+        void onRegister(std::function<void(uint8_t address, bool read, uint8_t value)> listener)
+        {
+            registerListeners_.push_back(listener);
+        }
+        uint8_t reg(uint8_t address) const { return regs_[address & 0x3F]; }
+
+        // ---------- Peripheral ----------
+        void onPinsChanged(Pic18 &mcu, int port) override;
+        void driveInputs(Pic18 &mcu, int port, uint8_t &levels) override;
+
+    private:
+        enum CardState
+        {
+            CardIdle,
+            CardReady,
+            CardActive,
+            CardHalt
+        };
+
+        struct FieldCard
+        {
+            Card card;
+            CardState state;
+            uint64_t enterCycle;
+            uint64_t sckEdgesAtEnter;
+            uint64_t transactionsAtEnter;
+            bool reported;
+        };
+
+        struct Answer
+        {
+            std::vector<uint8_t> bytes;
+            bool collision;
+            uint32_t uidFrom; // ANTICOLL answer: UID of the card, 0 = other answer
+        };
+
+        void resetChip();
+        void clockEdge(bool rising);
+        uint8_t readRegister(uint8_t address);
+        void writeRegister(uint8_t address, uint8_t value);
+
+        void startCommand(uint8_t command);
+        void startTransmit();
+        void finishTransmit(unsigned generation, const std::vector<uint8_t> &frame, unsigned lastBits);
+        void finishReceive(unsigned generation, const Answer &answer);
+        uint64_t timerPeriod() const;
+        void startTimer();
+        void calculateCrc();
+        void pushFifo(uint8_t value);
+        void setIrq(uint8_t address, uint8_t mask);
+
+        bool antennaOn() const;
+        Answer cardsAnswer(const std::vector<uint8_t> &frame, unsigned lastBits);
+        void enterField(const Card &card);
+        void powerCards();
+        void uidRead();
+        void registerAccessed(bool read, uint8_t value);
+
+        static uint16_t crcA(const uint8_t *data, size_t length, uint8_t preset);
+        static uint64_t rfCycles(double carrierPeriods);
+
+        Pic18 &mcu_;
+
+        // SPI
+        bool cs_;
+        bool sck_;
+        bool mosi_;
+        bool miso_;
+        bool rst_;
+        uint8_t shiftIn_;
+        uint8_t shiftOut_;
+        unsigned bitCount_;
+        bool haveAddress_;
+        bool readFrame_;
+        uint8_t address_;
+
+        // Chip
+        uint8_t regs_[64];
+        std::deque<uint8_t> fifo_;
+        bool transmitting_;
+        unsigned generation_;      // Bumped by every command to drop in-flight RF events
+        unsigned timerGeneration_; // Bumped to stop the timer
+
+        std::vector<FieldCard> field_;
+        unsigned uidBytesLeft_; // ANTICOLL answer bytes still in the FIFO
+        uint32_t uidFrom_;
+
+        uint64_t sckEdges_;
+        uint64_t transactions_;
+        uint64_t framesSent_;
+        uint64_t uidReads_;
+        std::vector<Detection> detections_;
+        std::vector<std::function<void(const Detection &)>> listeners_;
+        std::vector<std::function<void(uint8_t, bool, uint8_t)>> registerListeners_;
+    };
+
+    // The 4 UID bytes as one number, first byte highest
+    uint32_t uidKey(const Mfrc522::Card &card);
+}
+
+#endif
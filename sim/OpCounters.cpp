@@ -0,0 +1,302 @@
+#include "OpCounters.h"
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+
+namespace sim
+{
+    /* =======================================
+     *              CONSTANTS
+     * ======================================= */
+
+    // MFRC522 registers and IRQ bits as used by RFID_Motor (TRFID.h)
+    constexpr uint8_t kComIrqReg = 0x04;
+    constexpr uint8_t kBitFramingReg = 0x0D;
+    constexpr uint8_t kRxIdleIrq = 0x30;
+
+    // Runs 'call' as operation 'op' of the current counters
+    template <typename Call>
+    auto measure(const char *op, Call call) -> decltype(call())
+    {
+        struct Scope
+        {
+            const char *op;
+            Scope(const char *name) : op(name)
+            {
+                if (OpCounters::current())
+                    OpCounters::current()->begin();
+            }
+            ~Scope()
+            {
+                if (OpCounters::current())
+                    OpCounters::current()->end(op);
+            }
+        } scope(op);
+        return call();
+    }
+}
+
+/* =======================================
+ *              FIRMWARE HOOKS
+ * ======================================= */
+// The Makefile compiles each of these firmware functions under the name
+// <name>_fw (-D<name>=<name>_fw on its source file only), so the calls from
+// the other modules land here.
+
+void RFID_Motor_fw(void);
+void RFID_Motor(void)
+{
+    sim::OpCounters *counters = sim::OpCounters::current();
+    if (counters)
+        counters->begin();
+    RFID_Motor_fw();
+    if (counters)
+        counters->endRfidMotor();
+}
+
+unsigned char EEPROM_StoreConfigForUser_fw(unsigned char user, const unsigned char *led_config);
+unsigned char EEPROM_StoreConfigForUser(unsigned char user, const unsigned char *led_config)
+{
+    return sim::measure("EEPROM_StoreConfigForUser", [&]
+                        { return EEPROM_StoreConfigForUser_fw(user, led_config); });
+}
+
+unsigned char EEPROM_ReadConfigForUser_fw(unsigned char user, unsigned char *led_config);
+unsigned char EEPROM_ReadConfigForUser(unsigned char user, unsigned char *led_config)
+{
+    return sim::measure("EEPROM_ReadConfigForUser", [&]
+                        { return EEPROM_ReadConfigForUser_fw(user, led_config); });
+}
+
+void LCD_WriteUserInfo_fw(unsigned char last_uid_char, const unsigned char *light_config);
+void LCD_WriteUserInfo(unsigned char last_uid_char, const unsigned char *light_config)
+{
+    sim::measure("LCD_WriteUserInfo", [&]
+                 { LCD_WriteUserInfo_fw(last_uid_char, light_config); });
+}
+
+void LCD_UpdateLightConfig_fw(const unsigned char *light_config);
+void LCD_UpdateLightConfig(const unsigned char *light_config)
+{
+    sim::measure("LCD_UpdateLightConfig", [&]
+                 { LCD_UpdateLightConfig_fw(light_config); });
+}
+
+void LCD_UpdateTime_fw(unsigned char hour, unsigned char minute);
+void LCD_UpdateTime(unsigned char hour, unsigned char minute)
+{
+    sim::measure("LCD_UpdateTime", [&]
+                 { LCD_UpdateTime_fw(hour, minute); });
+}
+
+void SIO_SendDetectedCard_fw(const unsigned char *uid_bytes, const unsigned char *config);
+void SIO_SendDetectedCard(const unsigned char *uid_bytes, const unsigned char *config)
+{
+    sim::measure("SIO_SendDetectedCard", [&]
+                 { SIO_SendDetectedCard_fw(uid_bytes, config); });
+}
+
+unsigned char USER_FindPositionByRFID_fw(const unsigned char *rfid_uid);
+unsigned char USER_FindPositionByRFID(const unsigned char *rfid_uid)
+{
+    return sim::measure("USER_FindPositionByRFID", [&]
+                        { return USER_FindPositionByRFID_fw(rfid_uid); });
+}
+
+namespace sim
+{
+    /* =======================================
+     *              COUNTERS
+     * ======================================= */
+
+    OpCounters *OpCounters::current_ = nullptr;
+
+    OpCounters::OpCounters(Pic18 &mcu, Mfrc522 &rfid, Hd44780 &lcd)
+        : mcu_(mcu), rfid_(rfid), lcd_(lcd), sfr_(0), uart_(0)
+    {
+        mcu.onAccess([this](const SfrAccess &access)
+                     {
+            if (access.inIsr)
+                return;
+            sfr_++;
+            if (access.write && access.address == kTXREG)
+                uart_++; });
+        rfid.onRegister([this](uint8_t address, bool read, uint8_t value)
+                        {
+            for (Open &open : open_)
+            {
+                if (open.rfidAccessed)
+                    continue;
+                open.rfidAccessed = true;
+                open.rfidAddress = address;
+                open.rfidRead = read;
+                open.rfidValue = value;
+            } });
+        current_ = this;
+    }
+
+    OpCounters::~OpCounters()
+    {
+        if (current_ == this)
+            current_ = nullptr;
+    }
+
+    OpCounters::Counts OpCounters::now() const
+    {
+        Counts counts;
+        counts.sfr = sfr_;
+        counts.sck = rfid_.sckEdges();
+        counts.eeprom = mcu_.eepromWrites();
+        counts.uart = uart_;
+        counts.lcd = lcd_.enablePulses();
+        counts.cycles = mcu_.cycle() - mcu_.interruptCycles();
+        return counts;
+    }
+
+    void OpCounters::begin()
+    {
+        open_.push_back({now(), false, 0, false, 0});
+    }
+
+    void OpCounters::end(const std::string &op)
+    {
+        if (open_.empty())
+            return;
+        Counts start = open_.back().start;
+        open_.pop_back();
+
+        Counts stop = now();
+        Counts used;
+        used.sfr = stop.sfr - start.sfr;
+        used.sck = stop.sck - start.sck;
+        used.eeprom = stop.eeprom - start.eeprom;
+        used.uart = stop.uart - start.uart;
+        used.lcd = stop.lcd - start.lcd;
+        used.cycles = stop.cycles - start.cycles;
+
+        Stats &stats = ops_[op];
+        stats.calls++;
+        stats.total.sfr += used.sfr;
+        stats.total.sck += used.sck;
+        stats.total.eeprom += used.eeprom;
+        stats.total.uart += used.uart;
+        stats.total.lcd += used.lcd;
+        stats.total.cycles += used.cycles;
+        stats.max.sfr = std::max(stats.max.sfr, used.sfr);
+        stats.max.sck = std::max(stats.max.sck, used.sck);
+        stats.max.eeprom = std::max(stats.max.eeprom, used.eeprom);
+        stats.max.uart = std::max(stats.max.uart, used.uart);
+        stats.max.lcd = std::max(stats.max.lcd, used.lcd);
+        stats.max.cycles = std::max(stats.max.cycles, used.cycles);
+    }
+
+    void OpCounters::endRfidMotor()
+    {
+        if (open_.empty())
+            return;
+        const Open &open = open_.back();
+        const char *state;
+        if (!open.rfidAccessed)
+            state = "RFID_Motor/wait";
+        else if (!open.rfidRead && open.rfidAddress == kBitFramingReg)
+            state = "RFID_Motor/request";
+        else if (open.rfidRead && open.rfidAddress == kComIrqReg)
+            state = (open.rfidValue & kRxIdleIrq) ? "RFID_Motor/answer" : "RFID_Motor/poll";
+        else
+            state = "RFID_Motor/unknown";
+        end(state);
+    }
+
+    /* =======================================
+     *               BUDGETS
+     * ======================================= */
+
+    bool OpCounters::loadBudgets(const char *path, std::string &error)
+    {
+        std::ifstream file(path);
+        if (!file)
+        {
+            error = std::string("cannot open ") + path;
+            return false;
+        }
+        std::string line;
+        for (int number = 1; std::getline(file, line); number++)
+        {
+            std::istringstream in(line);
+            std::string op;
+            if (!(in >> op) || op[0] == '#')
+                continue;
+            Counts budget;
+            if (!(in >> budget.sfr >> budget.sck >> budget.eeprom >> budget.uart >> budget.lcd))
+            {
+                error = std::string(path) + ":" + std::to_string(number) + ": OP SFR SCK EEPROM UART LCD";
+                return false;
+            }
+            budgets_[op] = budget;
+        }
+        return true;
+    }
+
+    void OpCounters::report(FILE *out) const
+    {
+        std::fprintf(out, "Operations:  per call, main context (avg/max)\n");
+        std::fprintf(out, "  %-26s %6s %15s %13s %7s %9s %9s %13s\n", "op", "calls", "sfr", "sck", "eeprom",
+                     "uart", "lcd E", "us");
+        for (const auto &entry : ops_)
+        {
+            const Stats &stats = entry.second;
+            double calls = (double)stats.calls;
+            auto column = [calls](uint64_t total, uint64_t max)
+            {
+                char text[48];
+                std::snprintf(text, sizeof(text), "%.0f/%llu", total / calls, (unsigned long long)max);
+                return std::string(text);
+            };
+            std::fprintf(out, "  %-26s %6llu %15s %13s %7s %9s %9s %6.0f/%-6.0f\n", entry.first.c_str(),
+                         (unsigned long long)stats.calls, column(stats.total.sfr, stats.max.sfr).c_str(),
+                         column(stats.total.sck, stats.max.sck).c_str(),
+                         column(stats.total.eeprom, stats.max.eeprom).c_str(),
+                         column(stats.total.uart, stats.max.uart).c_str(),
+                         column(stats.total.lcd, stats.max.lcd).c_str(),
+                         cyclesToUs(stats.total.cycles) / calls, cyclesToUs(stats.max.cycles));
+        }
+    }
+
+    bool OpCounters::checkBudgets(FILE *out) const
+    {
+        static const char *const kNames[] = {"sfr", "sck", "eeprom", "uart", "lcd"};
+        bool ok = true;
+        for (const auto &entry : ops_)
+        {
+            auto budget = budgets_.find(entry.first);
+            if (budget == budgets_.end())
+            {
+                std::fprintf(out, "Budget:      %s has no budget\n", entry.first.c_str());
+                ok = false;
+                continue;
+            }
+            const Counts &max = entry.second.max;
+            const Counts &limit = budget->second;
+            const uint64_t got[] = {max.sfr, max.sck, max.eeprom, max.uart, max.lcd};
+            const uint64_t allowed[] = {limit.sfr, limit.sck, limit.eeprom, limit.uart, limit.lcd};
+            for (int counter = 0; counter < 5; counter++)
+            {
+                if (got[counter] > allowed[counter])
+                {
+                    std::fprintf(out, "Budget:      %s %s %llu per call, budget %llu  <--\n", entry.first.c_str(),
+                                 kNames[counter], (unsigned long long)got[counter],
+                                 (unsigned long long)allowed[counter]);
+                    ok = false;
+                }
+            }
+        }
+        for (const auto &entry : budgets_)
+        {
+            if (!ops_.count(entry.first))
+                std::fprintf(out, "Budget:      %s not called\n", entry.first.c_str());
+        }
+        std::fprintf(out, "Budget:      %s\n", ok ? "OK" : "EXCEEDED");
+        return ok;
+    }
+}
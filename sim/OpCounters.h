@@ -0,0 +1,107 @@
+#ifndef SIM_OPCOUNTERS_H
+#define SIM_OPCOUNTERS_H
+
+#include "Hd44780.h"
+#include "Mfrc522.h"
+#include "Pic18.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <map>
+#include <string>
+#include <vector>
+
+/* =======================================
+ *      PER-OPERATION ACCESS COUNTERS
+ * ======================================= */
+/*
+ * Counts the hardware traffic of each call to a firmware API function. The
+ * host build hooks them (renamed definitions, see the Makefile); calls made
+ * from the module that defines the function are not seen.
+ *
+ * Per call, main context only (interrupts that land inside are left out):
+ * - sfr: SFR accesses
+ * - sck: MFRC522 SCK edges
+ * - eeprom: data EEPROM writes
+ * - uart: bytes written to TXREG
+ * - lcd: HD44780 E pulses
+ * - cycles: instruction cycles (not budgeted, they follow the bus waits)
+ *
+ * RFID_Motor is split by state, told apart by its first register access:
+ * none (RFID_Motor/wait, state 2), BitFramingReg write (RFID_Motor/request,
+ * state 0), ComIrqReg read without RxIRq/IdleIRq (RFID_Motor/poll, state 1)
+ * or with one (RFID_Motor/answer, state 1).
+ *
+ * BUDGETS (one line per operation, '#' starts a comment):
+ *   OP SFR SCK EEPROM UART LCD    maximum per call
+ * An operation that runs over a budget, or runs without one, fails the
+ * check. Budgeted operations the run never called are listed, not failed.
+ */
+
+namespace sim
+{
+    class OpCounters
+    {
+    public:
+        struct Counts
+        {
+            uint64_t sfr = 0;
+            uint64_t sck = 0;
+            uint64_t eeprom = 0;
+            uint64_t uart = 0;
+            uint64_t lcd = 0;
+            uint64_t cycles = 0;
+        };
+
+        OpCounters(Pic18 &mcu, Mfrc522 &rfid, Hd44780 &lcd);
+        ~OpCounters();
+
+        // The counters the wrappers report to (the last one created)
+        static OpCounters *current() { return current_; }
+
+        // Calls nest: each one is charged everything up to its end()
+        void begin();
+        void end(const std::string &op);
+        void endRfidMotor(); // end() under the name of the state that ran
+
+        bool loadBudgets(const char *path, std::string &error);
+        bool hasBudgets() const { return !budgets_.empty(); }
+
+        // Calls, average and maximum of each counter per operation
+        void report(FILE *out) const;
+        // FALSE when an operation runs over its budget or has none
+        bool checkBudgets(FILE *out) const;
+
+    private:
+        struct Stats
+        {
+            uint64_t calls = 0;
+            Counts total;
+            Counts max;
+        };
+
+        struct Open
+        {
+            Counts start;
+            bool rfidAccessed;
+            uint8_t rfidAddress; // First MFRC522 register accessed during the call
+            bool rfidRead;
+            uint8_t rfidValue;
+        };
+
+        Counts now() const;
+
+        static OpCounters *current_;
+
+        Pic18 &mcu_;
+        Mfrc522 &rfid_;
+        Hd44780 &lcd_;
+        uint64_t sfr_;
+        uint64_t uart_;
+        std::vector<Open> open_;
+        std::map<std::string, Stats> ops_;
+        std::map<std::string, Counts> budgets_;
+    };
+}
+
+#endif
@@ -0,0 +1,1093 @@
+#include "Pic18.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace sim
+{
+    /* =======================================
+     *              CONSTANTS
+     * ======================================= */
+
+    // Bits
+    constexpr uint8_t kGIE = 0x80, kPEIE = 0x40, kTMR0IE = 0x20, kTMR0IF = 0x04;
+    constexpr uint8_t kTXIF = 0x10, kRCIF = 0x20, kTMR1IF = 0x01, kTMR2IF = 0x02;
+    constexpr uint8_t kEEIF = 0x10;
+    constexpr uint8_t kRD = 0x01, kWR = 0x02, kWREN = 0x04;
+    constexpr uint8_t kTRMT = 0x02, kBRGH = 0x04, kTXEN = 0x20;
+    constexpr uint8_t kOERR = 0x02, kFERR = 0x04, kCREN = 0x10, kSPEN = 0x80;
+    constexpr uint8_t kABDEN = 0x01, kBRG16 = 0x08, kABDOVF = 0x80;
+    constexpr uint8_t kTMR0ON = 0x80, kT08BIT = 0x40, kT0CS = 0x20, kPSA = 0x08, kT0PS = 0x07;
+    constexpr uint8_t kRD16 = 0x80, kT1CKPS = 0x30, kTMR1CS = 0x02, kTMR1ON = 0x01;
+    constexpr uint8_t kT2OUTPS = 0x78, kTMR2ON = 0x04, kT2CKPS = 0x03;
+    constexpr uint8_t kCCPPWM = 0x0C, kP1AActiveLow = 0x0E, kDCB = 0x30;
+    constexpr uint8_t kCCPM = 0x0F, kCCPSpecialEvent = 0x0B;
+    constexpr uint8_t kSP = 0x1F, kSTKFLAGS = 0xC0;
+
+    constexpr unsigned kInterruptLatency = 3; // Cycles to vector (2-3 on the PIC18)
+    constexpr unsigned kRetfieCycles = 2;
+    constexpr uint64_t kEepromWriteCycles = msToCycles(4); // TWR typical
+    constexpr double kBaudTolerance = 0.03;                // Beyond 3% the receiver misreads bits
+    constexpr uint32_t kIsrReturnAddress = 0x0008;         // Pushed on the return stack on interrupts
+
+    constexpr uint32_t kFnvOffset = 2166136261u;
+    constexpr uint32_t kFnvPrime = 16777619u;
+
+    // CCP1 (ECCP, P1A) on RC2, CCP2 on RC1 (CCP2MX = RC1)
+    struct CcpChannel
+    {
+        uint16_t con;
+        uint16_t dutyHigh; // CCPRxL, also the low byte of the compare value
+        uint8_t pin;
+        bool enhanced; // CCP1M = 111x drives P1A active-low
+        uint16_t pir;  // CCPxIF
+        uint8_t flag;
+    };
+    constexpr CcpChannel kCcp[2] = {{kCCP1CON, kCCPR1L, 0x04, true, kPIR1, 0x04},
+                                    {kCCP2CON, kCCPR2L, 0x02, false, kPIR2, 0x01}};
+
+    constexpr bool isPort(uint16_t address) { return address >= kPORTA && address < kPORTA + kNumPorts; }
+    constexpr bool isLatch(uint16_t address) { return address >= kLATA && address < kLATA + kNumPorts; }
+    constexpr bool isTris(uint16_t address) { return address >= kTRISA && address < kTRISA + kNumPorts; }
+
+    // Reads that change state or whose value moves between events
+    constexpr bool readChanges(uint16_t address)
+    {
+        return isPort(address) || address == kRCREG || address == kTMR0L || address == kTMR0H ||
+               address == kTMR1L || address == kTMR1H || address == kTOSL || address == kTOSH || address == kTOSU;
+    }
+
+    /* =======================================
+     *         SFR PROXY ENTRY POINTS
+     * ======================================= */
+
+    uint8_t sfrRead(uint16_t address) { return Pic18::instance().read(address); }
+    void sfrWrite(uint16_t address, uint8_t value) { Pic18::instance().write(address, value); }
+    void sfrWriteField(uint16_t address, uint8_t mask, uint8_t value) { Pic18::instance().writeField(address, mask, value); }
+    uint16_t sfrRead16(uint16_t address) { return Pic18::instance().read16(address); }
+    void sfrWrite16(uint16_t address, uint16_t value) { Pic18::instance().write16(address, value); }
+    void interruptsDisable() { Pic18::instance().disableInterrupts(); }
+    void interruptsEnable() { Pic18::instance().enableInterrupts(); }
+
+    /* =======================================
+     *              LIFECYCLE
+     * ======================================= */
+
+    Pic18 &Pic18::instance()
+    {
+        static Pic18 mcu;
+        return mcu;
+    }
+
+    Pic18::Pic18()
+    {
+        reset();
+    }
+
+    void Pic18::reset()
+    {
+        std::memset(sfr_, 0, sizeof(sfr_));
+        for (int port = 0; port < kNumPorts; port++)
+            sfr_[(kTRISA + port) & 0xFF] = 0xFF; // All pins are inputs after reset
+        sfr_[kT0CON & 0xFF] = 0xFF;
+        sfr_[kTXSTA & 0xFF] = kTRMT;
+        sfr_[kBAUDCON & 0xFF] = 0x40; // RCIDL
+        sfr_[0xD3] = 0x40;            // OSCCON: 1 MHz until TiInit selects 8 MHz + PLL
+        sfr_[0xC1] = 0x0F;            // ADCON1: PBADEN = DIG
+
+        cycle_ = 0;
+        stopCycle_ = UINT64_MAX;
+        accessCost_ = 4; // Roughly what the XC8 bit-banging loops spend per pin access
+        isr_ = nullptr;
+        inIsr_ = false;
+
+        t0BaseCycle_ = 0;
+        t0BaseCount_ = 0;
+        tmr0hBuffer_ = 0;
+
+        t1BaseCycle_ = 0;
+        t1BaseCount_ = 0;
+        tmr1hBuffer_ = 0;
+
+        sfr_[kPR2 & 0xFF] = 0xFF;
+        t2BaseCycle_ = 0;
+        t2BaseCount_ = 0;
+        t2Postscale_ = 0;
+
+        ccpLevels_ = 0;
+        ccpFall_[0] = ccpFall_[1] = UINT64_MAX;
+
+        txPending_ = false;
+        txPendingValue_ = 0;
+        tsrBusy_ = false;
+        tsrValue_ = 0;
+        tsrDone_ = 0;
+        hostBaud_ = 0;
+        hostQueue_.clear();
+        rxBusy_ = false;
+        rxValue_ = 0;
+        rxBaud_ = 0;
+        rxStart_ = 0;
+        rxDone_ = 0;
+        abdEdges_ = 0;
+        abdStart_ = 0;
+        rxFifo_.clear();
+        txLog_.clear();
+
+        std::memset(eeprom_, 0xFF, sizeof(eeprom_)); // Blank part
+        eeUnlock_ = 0;
+        eeWriting_ = false;
+        eeAddress_ = 0;
+        eeData_ = 0;
+        eeDone_ = 0;
+        eepromWrites_ = 0;
+        std::memset(eepromWritesAt_, 0, sizeof(eepromWritesAt_));
+
+        std::memset(stack_, 0, sizeof(stack_));
+
+        ffMarker_ = 0;
+        ffMask_ = 0;
+        passHash_ = kFnvOffset;
+        passQuiet_ = false;
+        passIsrs_ = 0;
+        lastHash_ = 0;
+        lastSteady_ = false;
+        ffCycles_ = 0;
+        ffJumps_ = 0;
+
+        isrCount_ = 0;
+        isrCycles_ = 0;
+        isrMaxCycles_ = 0;
+
+        events_.clear();
+        peripherals_.clear();
+        accessListeners_.clear();
+        txListeners_.clear();
+    }
+
+    /* =======================================
+     *         CLOCK AND SCHEDULING
+     * ======================================= */
+
+    void Pic18::advance(uint64_t cycles)
+    {
+        uint64_t target = cycle_ + cycles;
+        for (;;)
+        {
+            uint64_t next = nextEvent();
+            if (next > target)
+                break;
+            cycle_ = std::max(cycle_, next);
+            processEvents();
+        }
+        cycle_ = target;
+    }
+
+    void Pic18::at(uint64_t cycle, std::function<void()> action)
+    {
+        events_.emplace(cycle, std::move(action));
+    }
+
+    void Pic18::enableFastForward(uint16_t markerAddress, uint8_t markerMask)
+    {
+        ffMarker_ = markerAddress;
+        ffMask_ = markerMask;
+        passQuiet_ = false; // The pass in progress was not tracked
+        lastSteady_ = false;
+    }
+
+    // A main context access: quiet accesses are di()/ei(), the loop marker and
+    // reads that neither change state nor move on their own
+    void Pic18::trackPass(uint16_t address, uint8_t value, uint8_t changed, bool write)
+    {
+        if (address == ffMarker_)
+        {
+            if (changed & ~ffMask_)
+                passQuiet_ = false;
+            if (changed & ffMask_)
+                passEnd();
+            return;
+        }
+        if (write ? address != kINTCON || (changed & ~kGIE) : readChanges(address))
+            passQuiet_ = false;
+        passHash_ = (passHash_ ^ ((uint32_t)address << 9 | (uint32_t)write << 8 | value)) * kFnvPrime;
+    }
+
+    // Two quiet passes in a row without interrupts that made the same accesses
+    // will repeat until the next event: jump to it
+    void Pic18::passEnd()
+    {
+        bool steady = passQuiet_ && isrCount_ == passIsrs_;
+        bool repeat = steady && lastSteady_ && passHash_ == lastHash_;
+        lastSteady_ = steady;
+        lastHash_ = passHash_;
+        passHash_ = kFnvOffset;
+        passQuiet_ = true;
+        passIsrs_ = isrCount_;
+        if (!repeat)
+            return;
+
+        uint64_t target = std::min(nextEvent(), stopCycle_);
+        if (target == UINT64_MAX || target <= cycle_)
+            return;
+        ffCycles_ += target - cycle_;
+        ffJumps_++;
+        advance(target - cycle_);
+    }
+
+    uint64_t Pic18::nextEvent() const
+    {
+        uint64_t next = UINT64_MAX;
+        if (timer0Running())
+            next = std::min(next, timer0Overflow());
+        if (timer1Running())
+            next = std::min(next, std::min(timer1Overflow(), std::min(timer1Match(0), timer1Match(1))));
+        if (timer2Running())
+            next = std::min(next, timer2Match());
+        next = std::min(next, std::min(ccpFall_[0], ccpFall_[1]));
+        if (tsrBusy_)
+            next = std::min(next, tsrDone_);
+        if (rxBusy_)
+            next = std::min(next, rxDone_);
+        if (eeWriting_)
+            next = std::min(next, eeDone_);
+        if (!events_.empty())
+            next = std::min(next, events_.begin()->first);
+        return next;
+    }
+
+    void Pic18::processEvents()
+    {
+        if (timer0Running() && timer0Overflow() <= cycle_)
+        {
+            uint64_t overflow = timer0Overflow();
+            setBit(kINTCON, kTMR0IF, true);
+            t0BaseCycle_ = overflow;
+            t0BaseCount_ = 0;
+        }
+        if (timer1Running())
+        {
+            // A special event reset comes before the overflow it would prevent
+            uint64_t match = std::min(timer1Match(0), timer1Match(1));
+            if (match <= cycle_)
+            {
+                for (int channel = 0; channel < 2; channel++)
+                {
+                    if (timer1Match(channel) == match)
+                        setBit(kCcp[channel].pir, kCcp[channel].flag, true);
+                }
+                t1BaseCycle_ = match;
+                t1BaseCount_ = 0;
+            }
+            else if (timer1Overflow() <= cycle_)
+            {
+                setBit(kPIR1, kTMR1IF, true);
+                t1BaseCycle_ = timer1Overflow();
+                t1BaseCount_ = 0;
+            }
+        }
+        for (int channel = 0; channel < 2; channel++)
+        {
+            if (ccpFall_[channel] <= cycle_)
+                ccpDutyEnd(channel);
+        }
+        if (timer2Running() && timer2Match() <= cycle_)
+        {
+            uint64_t match = timer2Match();
+            ccpPeriodStart(match);
+            if (++t2Postscale_ > ((peek(kT2CON) & kT2OUTPS) >> 3))
+            {
+                setBit(kPIR1, kTMR2IF, true);
+                t2Postscale_ = 0;
+            }
+            t2BaseCycle_ = match;
+            t2BaseCount_ = 0;
+        }
+        if (tsrBusy_ && tsrDone_ <= cycle_)
+            finishTransmit();
+        if (rxBusy_ && rxDone_ <= cycle_)
+            finishReceive();
+        if (eeWriting_ && eeDone_ <= cycle_)
+            finishEepromWrite();
+
+        while (!events_.empty() && events_.begin()->first <= cycle_)
+        {
+            std::function<void()> action = std::move(events_.begin()->second);
+            events_.erase(events_.begin());
+            action();
+        }
+    }
+
+    void Pic18::run(void (*entry)(void), uint64_t untilCycle)
+    {
+        stopCycle_ = untilCycle;
+        try
+        {
+            entry();
+        }
+        catch (const StopRequest &)
+        {
+        }
+        stopCycle_ = UINT64_MAX;
+    }
+
+    /* =======================================
+     *             INTERRUPTS
+     * ======================================= */
+
+    bool Pic18::interruptPending() const
+    {
+        if (bit(kINTCON, kTMR0IE) && bit(kINTCON, kTMR0IF))
+            return true;
+        if (!bit(kINTCON, kPEIE))
+            return false;
+        return (sfr_[kPIE1 & 0xFF] & sfr_[kPIR1 & 0xFF]) || (sfr_[kPIE2 & 0xFF] & sfr_[kPIR2 & 0xFF]);
+    }
+
+    void Pic18::maybeInterrupt()
+    {
+        if (inIsr_ || isr_ == nullptr || !bit(kINTCON, kGIE) || !interruptPending())
+            return;
+
+        inIsr_ = true;
+        setBit(kINTCON, kGIE, false);
+        uint8_t level = (sfr_[kSTKPTR & 0xFF] & kSP) + 1;
+        if (level <= 31)
+        {
+            sfr_[kSTKPTR & 0xFF] = (sfr_[kSTKPTR & 0xFF] & kSTKFLAGS) | level;
+            stack_[level] = kIsrReturnAddress;
+        }
+
+        uint64_t start = cycle_;
+        advance(kInterruptLatency);
+        isr_();
+        for (auto &listener : isrListeners_)
+            listener();
+        advance(kRetfieCycles);
+
+        uint64_t spent = cycle_ - start;
+        isrCount_++;
+        isrCycles_ += spent;
+        isrMaxCycles_ = std::max(isrMaxCycles_, spent);
+
+        if (level <= 31)
+            sfr_[kSTKPTR & 0xFF] = (sfr_[kSTKPTR & 0xFF] & kSTKFLAGS) | (level - 1);
+        setBit(kINTCON, kGIE, true);
+        inIsr_ = false;
+    }
+
+    void Pic18::disableInterrupts()
+    {
+        writeField(kINTCON, kGIE, 0);
+    }
+
+    void Pic18::enableInterrupts()
+    {
+        writeField(kINTCON, kGIE, kGIE);
+    }
+
+    /* =======================================
+     *             SFR ACCESS
+     * ======================================= */
+
+    void Pic18::access()
+    {
+        advance(accessCost_);
+        maybeInterrupt();
+        if (!inIsr_ && cycle_ >= stopCycle_)
+            throw StopRequest();
+    }
+
+    void Pic18::notify(uint16_t address, uint8_t value, bool write)
+    {
+        if (accessListeners_.empty())
+            return;
+        SfrAccess event = {address, value, write, inIsr_, cycle_};
+        for (auto &listener : accessListeners_)
+            listener(event);
+    }
+
+    uint8_t Pic18::read(uint16_t address)
+    {
+        access();
+        uint8_t value = load(address);
+        notify(address, value, false);
+        if (ffMask_ && !inIsr_)
+            trackPass(address, value, 0, false);
+        return value;
+    }
+
+    void Pic18::write(uint16_t address, uint8_t value)
+    {
+        access();
+        uint8_t before = registerValue(address);
+        store(address, value);
+        notify(address, registerValue(address), true);
+        if (ffMask_ && !inIsr_)
+            trackPass(address, registerValue(address), before ^ registerValue(address), true);
+        maybeInterrupt();
+    }
+
+    void Pic18::writeField(uint16_t address, uint8_t mask, uint8_t value)
+    {
+        access();
+        // BSF/BCF on a PORT register reads the pins and writes the latch
+        uint8_t current = isPort(address) ? pins(address - kPORTA) : peek(address);
+        uint8_t before = registerValue(address);
+        store(address, (current & ~mask) | (value & mask));
+        notify(address, registerValue(address), true);
+        if (ffMask_ && !inIsr_)
+            trackPass(address, registerValue(address), before ^ registerValue(address), true);
+        maybeInterrupt();
+    }
+
+    uint8_t Pic18::registerValue(uint16_t address) const
+    {
+        return isPort(address) ? latch(address - kPORTA) : peek(address);
+    }
+
+    uint16_t Pic18::read16(uint16_t address)
+    {
+        uint8_t low = read(address);
+        uint8_t high = read(address + 1);
+        if (address == kTMR0L)
+            high = tmr0hBuffer_; // TMR0H is latched when TMR0L is read
+        if (address == kTMR1L && (peek(kT1CON) & kRD16))
+            high = tmr1hBuffer_;
+        return (uint16_t)((high << 8) | low);
+    }
+
+    void Pic18::write16(uint16_t address, uint16_t value)
+    {
+        // High byte first: for Timer0 it goes to the TMR0H buffer, loaded on the TMR0L write
+        write(address + 1, value >> 8);
+        write(address, value & 0xFF);
+    }
+
+    uint8_t Pic18::load(uint16_t address)
+    {
+        if (isPort(address))
+            return pins(address - kPORTA);
+
+        switch (address)
+        {
+        case kTMR0L:
+        {
+            uint16_t count = timer0Count();
+            tmr0hBuffer_ = count >> 8;
+            return count & 0xFF;
+        }
+        case kTMR0H:
+            return tmr0hBuffer_;
+        case kTMR1L:
+        {
+            uint16_t count = timer1Count();
+            tmr1hBuffer_ = count >> 8;
+            return count & 0xFF;
+        }
+        case kTMR1H:
+            // RD16: latched by the TMR1L read
+            return (peek(kT1CON) & kRD16) ? tmr1hBuffer_ : timer1Count() >> 8;
+        case kTMR2:
+            return timer2Count();
+        case kRCREG:
+        {
+            uint8_t value = rxFifo_.empty() ? sfr_[kRCREG & 0xFF] : rxFifo_.front();
+            if (!rxFifo_.empty())
+                rxFifo_.pop_front();
+            sfr_[kRCREG & 0xFF] = value;
+            setBit(kPIR1, kRCIF, !rxFifo_.empty());
+            setBit(kRCSTA, kFERR, false);
+            return value;
+        }
+        case kTOSL:
+            return stack_[peek(kSTKPTR) & kSP] & 0xFF;
+        case kTOSH:
+            return (stack_[peek(kSTKPTR) & kSP] >> 8) & 0xFF;
+        case kTOSU:
+            return (stack_[peek(kSTKPTR) & kSP] >> 16) & 0x1F;
+        default:
+            return sfr_[address & 0xFF];
+        }
+    }
+
+    void Pic18::store(uint16_t address, uint8_t value)
+    {
+        if (address != kEECON2 && address != kEECON1)
+            eeUnlock_ = 0;
+
+        if (isPort(address) || isLatch(address))
+        {
+            int port = isPort(address) ? address - kPORTA : address - kLATA;
+            sfr_[(kLATA + port) & 0xFF] = value;
+            pinsChanged(port);
+            return;
+        }
+        if (isTris(address))
+        {
+            sfr_[address & 0xFF] = value;
+            pinsChanged(address - kTRISA);
+            return;
+        }
+
+        uint8_t &reg = sfr_[address & 0xFF];
+        switch (address)
+        {
+        case kT0CON:
+        {
+            uint16_t count = timer0Count();
+            reg = value;
+            timer0Rebase(count);
+            break;
+        }
+        case kTMR0L:
+            // Writing TMR0 clears the prescaler
+            timer0Rebase((uint16_t)((tmr0hBuffer_ << 8) | value));
+            break;
+        case kTMR0H:
+            tmr0hBuffer_ = value;
+            break;
+        case kT1CON:
+        {
+            uint16_t count = timer1Count();
+            reg = value;
+            timer1Rebase(count);
+            break;
+        }
+        case kTMR1L:
+            // Writing TMR1 clears the prescaler. RD16: TMR1H comes from its buffer
+            if (peek(kT1CON) & kRD16)
+                timer1Rebase((uint16_t)((tmr1hBuffer_ << 8) | value));
+            else
+                timer1Rebase((uint16_t)((timer1Count() & 0xFF00) | value));
+            break;
+        case kTMR1H:
+            if (peek(kT1CON) & kRD16)
+                tmr1hBuffer_ = value;
+            else
+            {
+                uint64_t fraction = timer1Running() ? (cycle_ - t1BaseCycle_) % timer1Prescale() : 0;
+                timer1Rebase((uint16_t)((value << 8) | (timer1Count() & 0xFF)));
+                t1BaseCycle_ -= fraction; // The prescaler keeps counting
+            }
+            break;
+        case kT2CON:
+        {
+            // Writing T2CON or TMR2 clears the prescaler and postscaler
+            uint8_t count = timer2Count();
+            reg = value;
+            timer2Rebase(count);
+            break;
+        }
+        case kTMR2:
+            timer2Rebase(value);
+            break;
+        case kPR2:
+        {
+            uint8_t count = timer2Count();
+            reg = value;
+            timer2Rebase(count);
+            t2Postscale_ = 0;
+            break;
+        }
+        case kPIR1:
+            reg = (value & ~(kTXIF | kRCIF)) | (reg & (kTXIF | kRCIF)); // Hardware flags
+            break;
+        case kCCP1CON:
+        case kCCP2CON:
+        {
+            int channel = address == kCCP1CON ? 0 : 1;
+            uint8_t before = driven(PortC);
+            reg = value;
+            if ((value & kCCPPWM) != kCCPPWM)
+            {
+                // Leaving PWM mode hands the pin back to the latch
+                ccpLevels_ &= ~kCcp[channel].pin;
+                ccpFall_[channel] = UINT64_MAX;
+            }
+            if (driven(PortC) != before)
+                pinsChanged(PortC);
+            break;
+        }
+        case kTXSTA:
+            if ((value & kTXEN) && !(reg & kTXEN) && !txPending_)
+                setBit(kPIR1, kTXIF, true);
+            reg = (value & ~kTRMT) | (reg & kTRMT);
+            break;
+        case kRCSTA:
+            if (!(value & kCREN))
+                value &= ~kOERR; // Clearing CREN resets the overrun error
+            else
+                value = (value & ~kOERR) | (reg & kOERR);
+            reg = (value & ~kFERR) | (reg & kFERR);
+            break;
+        case kTXREG:
+            storeTxreg(value);
+            break;
+        case kEECON2:
+            if (value == 0x55)
+                eeUnlock_ = 1;
+            else if (value == 0xAA && eeUnlock_ == 1)
+                eeUnlock_ = 2;
+            else
+                eeUnlock_ = 0;
+            break;
+        case kEECON1:
+            storeEecon1(value);
+            break;
+        case kSTKPTR:
+            reg = (value & kSP) | (reg & value & kSTKFLAGS); // Overflow flags can only be cleared
+            break;
+        case kTOSL:
+            stack_[peek(kSTKPTR) & kSP] = (stack_[peek(kSTKPTR) & kSP] & ~0xFFu) | value;
+            break;
+        case kTOSH:
+            stack_[peek(kSTKPTR) & kSP] = (stack_[peek(kSTKPTR) & kSP] & ~0xFF00u) | (value << 8);
+            break;
+        case kTOSU:
+            stack_[peek(kSTKPTR) & kSP] = (stack_[peek(kSTKPTR) & kSP] & 0xFFFFu) | ((uint32_t)(value & 0x1F) << 16);
+            break;
+        default:
+            reg = value;
+            break;
+        }
+    }
+
+    void Pic18::setBit(uint16_t address, uint8_t mask, bool value)
+    {
+        if (value)
+            sfr_[address & 0xFF] |= mask;
+        else
+            sfr_[address & 0xFF] &= ~mask;
+    }
+
+    /* =======================================
+     *                PINS
+     * ======================================= */
+
+    uint8_t Pic18::pins(int port)
+    {
+        uint8_t external = 0; // Undriven inputs read low
+        for (Peripheral *peripheral : peripherals_)
+            peripheral->driveInputs(*this, port, external);
+        return outputs(port) | (external & tris(port));
+    }
+
+    void Pic18::pinsChanged(int port)
+    {
+        for (Peripheral *peripheral : peripherals_)
+            peripheral->onPinsChanged(*this, port);
+    }
+
+    uint8_t Pic18::driven(int port) const
+    {
+        if (port != PortC)
+            return latch(port);
+        uint8_t pwm = ccpPwmPins();
+        return (latch(port) & ~pwm) | ((ccpLevels_ ^ ccpActiveLowPins()) & pwm);
+    }
+
+    /* =======================================
+     *               TIMER0
+     * ======================================= */
+
+    bool Pic18::timer0Running() const
+    {
+        uint8_t t0con = peek(kT0CON);
+        return (t0con & kTMR0ON) && !(t0con & kT0CS); // External clock (T0CKI) is not modelled
+    }
+
+    uint64_t Pic18::timer0Prescale() const
+    {
+        uint8_t t0con = peek(kT0CON);
+        if (t0con & kPSA)
+            return 1;
+        return 2ull << (t0con & kT0PS);
+    }
+
+    uint16_t Pic18::timer0Count() const
+    {
+        if (!timer0Running())
+            return t0BaseCount_;
+        uint64_t range = (peek(kT0CON) & kT08BIT) ? 0x100 : 0x10000;
+        return (uint16_t)((t0BaseCount_ + (cycle_ - t0BaseCycle_) / timer0Prescale()) % range);
+    }
+
+    void Pic18::timer0Rebase(uint16_t count)
+    {
+        if (peek(kT0CON) & kT08BIT)
+            count &= 0xFF;
+        t0BaseCount_ = count;
+        t0BaseCycle_ = cycle_;
+    }
+
+    uint64_t Pic18::timer0Overflow() const
+    {
+        uint64_t range = (peek(kT0CON) & kT08BIT) ? 0x100 : 0x10000;
+        return t0BaseCycle_ + (range - t0BaseCount_) * timer0Prescale();
+    }
+
+    /* =======================================
+     *               TIMER1
+     * ======================================= */
+
+    bool Pic18::timer1Running() const
+    {
+        uint8_t t1con = peek(kT1CON);
+        return (t1con & kTMR1ON) && !(t1con & kTMR1CS); // External clock (T1CKI, T1OSC) is not modelled
+    }
+
+    uint64_t Pic18::timer1Prescale() const
+    {
+        return 1ull << ((peek(kT1CON) & kT1CKPS) >> 4);
+    }
+
+    uint16_t Pic18::timer1Count() const
+    {
+        if (!timer1Running())
+            return t1BaseCount_;
+        // Special event resets and overflows rebase it when they happen
+        return (uint16_t)(t1BaseCount_ + (cycle_ - t1BaseCycle_) / timer1Prescale());
+    }
+
+    void Pic18::timer1Rebase(uint16_t count)
+    {
+        t1BaseCount_ = count;
+        t1BaseCycle_ = cycle_;
+    }
+
+    uint64_t Pic18::timer1Overflow() const
+    {
+        return t1BaseCycle_ + (0x10000 - (uint64_t)t1BaseCount_) * timer1Prescale();
+    }
+
+    uint64_t Pic18::timer1Match(int channel) const
+    {
+        const CcpChannel &ccp = kCcp[channel];
+        if ((peek(ccp.con) & kCCPM) != kCCPSpecialEvent)
+            return UINT64_MAX;
+        // First TMR1 = CCPRx after the base; a match already behind the count
+        // (CCPRx written below it) comes a lap later
+        uint16_t compare = (uint16_t)((peek(ccp.dutyHigh + 1) << 8) | peek(ccp.dutyHigh));
+        uint64_t counted = timer1Running() ? (cycle_ - t1BaseCycle_) / timer1Prescale() : 0;
+        uint64_t counts = (uint16_t)(compare - t1BaseCount_);
+        if (counts == 0)
+            counts = 0x10000;
+        while (counts < counted)
+            counts += 0x10000;
+        return t1BaseCycle_ + counts * timer1Prescale();
+    }
+
+    /* =======================================
+     *               TIMER2
+     * ======================================= */
+
+    bool Pic18::timer2Running() const
+    {
+        return (peek(kT2CON) & kTMR2ON) != 0;
+    }
+
+    uint64_t Pic18::timer2Prescale() const
+    {
+        uint8_t ckps = peek(kT2CON) & kT2CKPS;
+        return ckps == 0 ? 1 : ckps == 1 ? 4 : 16;
+    }
+
+    uint8_t Pic18::timer2Count() const
+    {
+        if (!timer2Running())
+            return t2BaseCount_;
+        // TMR2 counts up to PR2 and resets on the next increment
+        uint64_t period = (uint64_t)peek(kPR2) + 1;
+        uint64_t counted = (cycle_ - t2BaseCycle_) / timer2Prescale();
+        uint64_t toMatch = (uint8_t)(peek(kPR2) - t2BaseCount_) + 1;
+        if (counted < toMatch)
+            return (uint8_t)(t2BaseCount_ + counted);
+        return (uint8_t)((counted - toMatch) % period);
+    }
+
+    void Pic18::timer2Rebase(uint8_t count)
+    {
+        t2BaseCount_ = count;
+        t2BaseCycle_ = cycle_;
+        t2Postscale_ = 0;
+    }
+
+    uint64_t Pic18::timer2Period() const
+    {
+        return ((uint64_t)peek(kPR2) + 1) * timer2Prescale();
+    }
+
+    uint64_t Pic18::timer2FlagPeriod() const
+    {
+        return timer2Period() * (((peek(kT2CON) & kT2OUTPS) >> 3) + 1);
+    }
+
+    uint64_t Pic18::timer2Match() const
+    {
+        // From a count above PR2, TMR2 wraps through 0xFF first
+        uint64_t toMatch = (uint8_t)(peek(kPR2) - t2BaseCount_) + 1;
+        return t2BaseCycle_ + toMatch * timer2Prescale();
+    }
+
+    /* =======================================
+     *               CCP PWM
+     * ======================================= */
+
+    uint8_t Pic18::ccpPwmPins() const
+    {
+        uint8_t pins = 0;
+        for (const CcpChannel &ccp : kCcp)
+        {
+            if ((peek(ccp.con) & kCCPPWM) == kCCPPWM)
+                pins |= ccp.pin;
+        }
+        return pins;
+    }
+
+    uint8_t Pic18::ccpActiveLowPins() const
+    {
+        uint8_t pins = 0;
+        for (const CcpChannel &ccp : kCcp)
+        {
+            if (ccp.enhanced && (peek(ccp.con) & kP1AActiveLow) == kP1AActiveLow)
+                pins |= ccp.pin;
+        }
+        return pins;
+    }
+
+    // TMR2 = PR2 reset: each PWM output goes active (unless the duty is 0) and
+    // takes the CCPRxL:DCxB duty written during the previous period
+    void Pic18::ccpPeriodStart(uint64_t cycle)
+    {
+        uint8_t levels = ccpLevels_;
+        for (int channel = 0; channel < 2; channel++)
+        {
+            const CcpChannel &ccp = kCcp[channel];
+            ccpFall_[channel] = UINT64_MAX;
+            if ((peek(ccp.con) & kCCPPWM) != kCCPPWM)
+                continue;
+            // Duty in Tosc * prescaler units, 4 Tosc per cycle
+            uint64_t duty = ((uint64_t)peek(ccp.dutyHigh) << 2) | ((peek(ccp.con) & kDCB) >> 4);
+            uint64_t period = ((uint64_t)peek(kPR2) + 1) * 4;
+            if (duty == 0)
+                levels &= ~ccp.pin;
+            else
+                levels |= ccp.pin;
+            if (duty > 0 && duty < period)
+                ccpFall_[channel] = cycle + (duty * timer2Prescale() + 3) / 4;
+        }
+        if (levels != ccpLevels_)
+        {
+            ccpLevels_ = levels;
+            pinsChanged(PortC);
+        }
+    }
+
+    void Pic18::ccpDutyEnd(int channel)
+    {
+        ccpFall_[channel] = UINT64_MAX;
+        ccpLevels_ &= ~kCcp[channel].pin;
+        pinsChanged(PortC);
+    }
+
+    /* =======================================
+     *               EUSART
+     * ======================================= */
+
+    uint64_t Pic18::uartBitCycles() const
+    {
+        bool brg16 = bit(kBAUDCON, kBRG16);
+        bool brgh = bit(kTXSTA, kBRGH);
+        uint32_t divisor = brg16 ? ((peek(kSPBRGH) << 8) | peek(kSPBRG)) : peek(kSPBRG);
+        uint32_t fosc_per_bit = (!brg16 && !brgh) ? 64 : ((brg16 && brgh) ? 4 : 16);
+        return (uint64_t)fosc_per_bit * (divisor + 1) / 4;
+    }
+
+    double Pic18::uartBaud() const
+    {
+        return (double)kFcy / (double)uartBitCycles();
+    }
+
+    bool Pic18::baudMatches(double baud) const
+    {
+        return std::fabs(uartBaud() - baud) / baud <= kBaudTolerance;
+    }
+
+    void Pic18::storeTxreg(uint8_t value)
+    {
+        if (!bit(kTXSTA, kTXEN) || !bit(kRCSTA, kSPEN))
+            return;
+
+        if (!tsrBusy_)
+        {
+            // TXREG moves straight into the shift register
+            tsrBusy_ = true;
+            tsrValue_ = value;
+            tsrDone_ = cycle_ + 10 * uartBitCycles();
+            setBit(kTXSTA, kTRMT, false);
+            setBit(kPIR1, kTXIF, true);
+        }
+        else
+        {
+            txPending_ = true;
+            txPendingValue_ = value;
+            setBit(kPIR1, kTXIF, false);
+        }
+    }
+
+    void Pic18::finishTransmit()
+    {
+        UartByte sent = {tsrValue_, tsrDone_, hostBaud_ == 0 || baudMatches(hostBaud_)};
+        txLog_.push_back(sent);
+        for (auto &listener : txListeners_)
+            listener(sent);
+
+        if (txPending_)
+        {
+            txPending_ = false;
+            tsrValue_ = txPendingValue_;
+            tsrDone_ += 10 * uartBitCycles();
+            setBit(kPIR1, kTXIF, true);
+        }
+        else
+        {
+            tsrBusy_ = false;
+            setBit(kTXSTA, kTRMT, true);
+        }
+    }
+
+    void Pic18::hostSend(uint8_t value)
+    {
+        hostQueue_.push_back(value);
+        if (!rxBusy_)
+            startReceive();
+    }
+
+    void Pic18::hostSend(const char *text)
+    {
+        while (*text)
+            hostSend((uint8_t)*text++);
+    }
+
+    void Pic18::startReceive()
+    {
+        if (hostQueue_.empty())
+            return;
+        rxBusy_ = true;
+        rxValue_ = hostQueue_.front();
+        hostQueue_.pop_front();
+        rxBaud_ = hostBaud_ ? (double)hostBaud_ : uartBaud();
+        rxStart_ = cycle_;
+        rxDone_ = cycle_ + (uint64_t)std::llround(10.0 * (double)kFcy / rxBaud_); // Start + 8 data + stop
+    }
+
+    void Pic18::finishReceive()
+    {
+        rxBusy_ = false;
+        uint8_t value = rxValue_;
+
+        if (!bit(kBAUDCON, kABDEN))
+            abdEdges_ = 0;
+
+        if (bit(kRCSTA, kSPEN) && bit(kRCSTA, kCREN))
+        {
+            bool received = true;
+            if (bit(kBAUDCON, kABDEN))
+            {
+                // Auto-baud: the BRG counts from the first rising edge on RX to
+                // the fifth, 8 bit times in a 'U' (bits 0, 2, 4, 6 and stop).
+                // Any other character puts them elsewhere, or has fewer and the
+                // count runs on into the next characters. RCIF at the fifth
+                // edge, RCREG holds no real character
+                double bitCycles = (double)kFcy / rxBaud_;
+                double fifthEdge = 0;
+                int level = 0; // Start bit
+                for (int k = 1; k <= 9 && abdEdges_ < 5; k++)
+                {
+                    int next = k == 9 ? 1 : (value >> (k - 1)) & 1;
+                    if (next && !level)
+                    {
+                        double edge = (double)rxStart_ + k * bitCycles;
+                        if (abdEdges_ == 0)
+                            abdStart_ = edge;
+                        if (++abdEdges_ == 5)
+                            fifthEdge = edge;
+                    }
+                    level = next;
+                }
+                received = abdEdges_ == 5;
+                if (received)
+                {
+                    bool brg16 = bit(kBAUDCON, kBRG16);
+                    bool brgh = bit(kTXSTA, kBRGH);
+                    double fosc_per_bit = (!brg16 && !brgh) ? 64 : ((brg16 && brgh) ? 4 : 16);
+                    double measured_bit = (fifthEdge - abdStart_) / 8 * (double)(kFosc / kFcy); // In Fosc clocks
+                    long divisor = std::lround(measured_bit / fosc_per_bit) - 1;
+                    if (divisor > 0xFFFF)
+                        setBit(kBAUDCON, kABDOVF, true); // The counter rolled over
+                    sfr_[kSPBRGH & 0xFF] = (uint8_t)(divisor >> 8);
+                    sfr_[kSPBRG & 0xFF] = (uint8_t)divisor;
+                    setBit(kBAUDCON, kABDEN, false);
+                    abdEdges_ = 0;
+                    value = 0x00;
+                }
+            }
+            else if (!baudMatches(rxBaud_))
+            {
+                value = 0xFF; // Bits sampled at the wrong time
+                setBit(kRCSTA, kFERR, true);
+            }
+
+            if (received && rxFifo_.size() < 2)
+            {
+                rxFifo_.push_back(value);
+                setBit(kPIR1, kRCIF, true);
+            }
+            else if (received)
+            {
+                setBit(kRCSTA, kOERR, true);
+            }
+        }
+
+        startReceive();
+        if (rxBusy_)
+            rxDone_ = std::max(rxDone_, cycle_ + 1);
+    }
+
+    /* =======================================
+     *               EEPROM
+     * ======================================= */
+
+    void Pic18::storeEecon1(uint8_t value)
+    {
+        uint8_t &reg = sfr_[kEECON1 & 0xFF];
+        bool start_write = (value & kWR) && !(reg & kWR) && (value & kWREN) && eeUnlock_ == 2 && !eeWriting_;
+        eeUnlock_ = 0;
+
+        if (value & kRD)
+            sfr_[kEEDATA & 0xFF] = eeprom_[peek(kEEADR)];
+
+        // RD is cleared by hardware, WR can only be set by software
+        reg = (value & ~(kRD | kWR)) | (reg & kWR);
+        if (start_write)
+        {
+            reg |= kWR;
+            eeWriting_ = true;
+            eeAddress_ = peek(kEEADR);
+            eeData_ = peek(kEEDATA);
+            eeDone_ = cycle_ + kEepromWriteCycles;
+        }
+    }
+
+    void Pic18::finishEepromWrite()
+    {
+        eeWriting_ = false;
+        eeprom_[eeAddress_] = eeData_;
+        eepromWrites_++;
+        eepromWritesAt_[eeAddress_]++;
+        setBit(kEECON1, kWR, false);
+        setBit(kPIR2, kEEIF, true);
+    }
+}
@@ -0,0 +1,343 @@
+#ifndef SIM_PIC18_H
+#define SIM_PIC18_H
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <vector>
+
+/* =======================================
+ *        PIC18F4321 HOST SIMULATOR
+ * ======================================= */
+/*
+ * Register-level model of the peripherals the firmware touches:
+ * - Timer0 (8/16-bit, prescaler, TMR0IF) and the single interrupt vector
+ * - Timer1 (16-bit, internal clock, prescaler, RD16 buffer, TMR1IF)
+ * - Timer2 (prescaler, PR2 auto-reload, postscaler, TMR2IF)
+ * - CCP1/CCP2 PWM on Timer2 (10-bit duty latched at each period start),
+ *   driving RC2 and RC1 (CCP2MX = RC1) over the PORTC latch; CCP1 P1A
+ *   active-low with CCP1M = 111x
+ * - CCP1/CCP2 compare on Timer1 with the special event trigger
+ *   (CCPxM = 1011): CCPxIF and a Timer1 reset on TMR1 = CCPRx
+ * - EUSART TX/RX (TXIF, TRMT, RCIF, 2-byte RX FIFO, BRG16/BRGH), auto-baud
+ *   timing RX rising edges 1 to 5 like the silicon: right for a 'U' only
+ * - Data EEPROM (EECON2 0x55/0xAA unlock, WR for ~4ms, EEIF)
+ * - PORTA-E latch/port/tris, with pluggable external devices
+ * - Hardware return stack (STKPTR/TOSx), so TMemory can paint it
+ *
+ * TIMING:
+ * - The virtual clock counts instruction cycles (Fosc 32 MHz -> Fcy 8 MHz)
+ * - Every SFR access costs accessCost() cycles; firmware code between two
+ *   accesses is free. Busy-wait loops always poll an SFR or di()/ei(), so the
+ *   clock keeps moving and time-dependent logic behaves as on the board
+ * - Interrupts are taken between two SFR accesses of the main context
+ * - Fast-forward (optional): once two main loop passes in a row made the
+ *   same side-effect free accesses, the firmware can only change course on
+ *   the next event (Timer0 overflow, UART, EEPROM, scheduled action), so the
+ *   clock jumps straight to it. Idle minutes and hours then cost a few
+ *   passes per 2 ms tick instead of hundreds
+ *
+ * The firmware keeps its state in file-scope statics, so there is a single
+ * MCU per process (Pic18::instance()).
+ */
+
+namespace sim
+{
+    constexpr uint64_t kFosc = 32000000;
+    constexpr uint64_t kFcy = kFosc / 4;
+
+    constexpr uint64_t usToCycles(uint64_t us) { return us * (kFcy / 1000000); }
+    constexpr uint64_t msToCycles(uint64_t ms) { return ms * (kFcy / 1000); }
+    constexpr double cyclesToUs(uint64_t cycles) { return (double)cycles * 1e6 / (double)kFcy; }
+
+    enum Port
+    {
+        PortA,
+        PortB,
+        PortC,
+        PortD,
+        PortE,
+        kNumPorts
+    };
+
+    // SFR addresses used by the models
+    enum Sfr : uint16_t
+    {
+        kPORTA = 0xF80,
+        kLATA = 0xF89,
+        kTRISA = 0xF92,
+        kPIE1 = 0xF9D,
+        kPIR1 = 0xF9E,
+        kPIE2 = 0xFA0,
+        kPIR2 = 0xFA1,
+        kEECON1 = 0xFA6,
+        kEECON2 = 0xFA7,
+        kEEDATA = 0xFA8,
+        kEEADR = 0xFA9,
+        kRCSTA = 0xFAB,
+        kTXSTA = 0xFAC,
+        kTXREG = 0xFAD,
+        kRCREG = 0xFAE,
+        kSPBRG = 0xFAF,
+        kSPBRGH = 0xFB0,
+        kBAUDCON = 0xFB8,
+        kCCP2CON = 0xFBA,
+        kCCPR2L = 0xFBB,
+        kCCPR2H = 0xFBC,
+        kCCP1CON = 0xFBD,
+        kCCPR1L = 0xFBE,
+        kCCPR1H = 0xFBF,
+        kT1CON = 0xFCD,
+        kTMR1L = 0xFCE,
+        kTMR1H = 0xFCF,
+        kT2CON = 0xFCA,
+        kPR2 = 0xFCB,
+        kTMR2 = 0xFCC,
+        kT0CON = 0xFD5,
+        kTMR0L = 0xFD6,
+        kTMR0H = 0xFD7,
+        kINTCON = 0xFF2,
+        kSTKPTR = 0xFFC,
+        kTOSL = 0xFFD,
+        kTOSH = 0xFFE,
+        kTOSU = 0xFFF
+    };
+
+    struct SfrAccess
+    {
+        uint16_t address;
+        uint8_t value; // Value read, or register value after the write
+        bool write;
+        bool inIsr;
+        uint64_t cycle;
+    };
+
+    struct UartByte
+    {
+        uint8_t value;
+        uint64_t cycle; // Stop bit end
+        bool framingOk; // FALSE when the other side runs at a different baud rate
+    };
+
+    class Pic18;
+
+    // External hardware wired to the port pins
+    class Peripheral
+    {
+    public:
+        virtual ~Peripheral() = default;
+
+        // A LAT/PORT/TRIS register of 'port' has been written
+        virtual void onPinsChanged(Pic18 &mcu, int port) {}
+
+        // 'port' is being read: set the levels of the pins this device drives
+        virtual void driveInputs(Pic18 &mcu, int port, uint8_t &levels) {}
+    };
+
+    // Thrown from the main context to leave the firmware's endless loop
+    struct StopRequest
+    {
+    };
+
+    class Pic18
+    {
+    public:
+        static Pic18 &instance();
+
+        void reset();
+
+        // ---------- Clock and scheduling ----------
+        uint64_t cycle() const { return cycle_; }
+        void setAccessCost(unsigned cycles) { accessCost_ = cycles; }
+        unsigned accessCost() const { return accessCost_; }
+        void advance(uint64_t cycles);
+        void at(uint64_t cycle, std::function<void()> action);
+
+        // Main loop passes are delimited by 'markerMask' toggling in 'markerAddress'
+        void enableFastForward(uint16_t markerAddress, uint8_t markerMask);
+        uint64_t fastForwardCycles() const { return ffCycles_; }
+        uint64_t fastForwardJumps() const { return ffJumps_; }
+
+        // ---------- Firmware ----------
+        void setInterruptHandler(void (*handler)(void)) { isr_ = handler; }
+        void run(void (*entry)(void), uint64_t untilCycle);
+        bool inInterrupt() const { return inIsr_; }
+
+        // ---------- SFR access from the proxies ----------
+        uint8_t read(uint16_t address);
+        void write(uint16_t address, uint8_t value);
+        void writeField(uint16_t address, uint8_t mask, uint8_t value);
+        uint16_t read16(uint16_t address);
+        void write16(uint16_t address, uint16_t value);
+        void disableInterrupts();
+        void enableInterrupts();
+        uint8_t peek(uint16_t address) const { return sfr_[address & 0xFF]; }
+
+        // ---------- Pins ----------
+        void attach(Peripheral *peripheral) { peripherals_.push_back(peripheral); }
+        uint8_t latch(int port) const { return sfr_[(kLATA + port) & 0xFF]; }
+        uint8_t tris(int port) const { return sfr_[(kTRISA + port) & 0xFF]; }
+        uint8_t outputs(int port) const { return driven(port) & ~tris(port); }
+        uint8_t pins(int port);
+
+        // ---------- Timer2 and CCP PWM ----------
+        uint64_t timer2Period() const;     // Cycles between two TMR2 = PR2 resets
+        uint64_t timer2FlagPeriod() const; // Cycles between two TMR2IF (postscaler)
+        uint8_t ccpPwmPins() const;        // PORTC pins driven by a CCP in PWM mode
+        uint8_t ccpActiveLowPins() const;  // CCP pins whose PWM output is active-low
+
+        // ---------- UART, PC side ----------
+        void setHostBaud(uint32_t baud) { hostBaud_ = baud; } // 0 = always matches the PIC
+        void hostSend(uint8_t value);
+        void hostSend(const char *text);
+        double uartBaud() const;
+        const std::vector<UartByte> &txLog() const { return txLog_; }
+        void onTransmit(std::function<void(const UartByte &)> listener) { txListeners_.push_back(listener); }
+
+        // ---------- EEPROM ----------
+        uint8_t eeprom(uint8_t address) const { return eeprom_[address]; }
+        void setEeprom(uint8_t address, uint8_t value) { eeprom_[address] = value; }
+        uint64_t eepromWrites() const { return eepromWrites_; }
+        uint32_t eepromWrites(uint8_t address) const { return eepromWritesAt_[address]; }
+
+        // ---------- Observation ----------
+        void onAccess(std::function<void(const SfrAccess &)> listener) { accessListeners_.push_back(listener); }
+        void onInterruptReturn(std::function<void()> listener) { isrListeners_.push_back(listener); }
+        uint64_t interruptCount() const { return isrCount_; }
+        uint64_t interruptCycles() const { return isrCycles_; }
+        uint64_t interruptMaxCycles() const { return isrMaxCycles_; }
+
+    private:
+        Pic18();
+
+        void access();
+        void notify(uint16_t address, uint8_t value, bool write);
+        uint8_t registerValue(uint16_t address) const;
+        uint8_t load(uint16_t address);
+        void store(uint16_t address, uint8_t value);
+        void pinsChanged(int port);
+        uint8_t driven(int port) const; // Latch, or the CCP output on the pins in PWM mode
+
+        void trackPass(uint16_t address, uint8_t value, uint8_t changed, bool write);
+        void passEnd();
+
+        uint64_t nextEvent() const;
+        void processEvents();
+        bool interruptPending() const;
+        void maybeInterrupt();
+
+        void setBit(uint16_t address, uint8_t mask, bool value);
+        bool bit(uint16_t address, uint8_t mask) const { return (sfr_[address & 0xFF] & mask) != 0; }
+
+        // Timer0
+        bool timer0Running() const;
+        uint64_t timer0Prescale() const;
+        uint16_t timer0Count() const;
+        void timer0Rebase(uint16_t count);
+        uint64_t timer0Overflow() const;
+
+        // Timer1 and the CCP special event trigger
+        bool timer1Running() const;
+        uint64_t timer1Prescale() const;
+        uint16_t timer1Count() const;
+        void timer1Rebase(uint16_t count);
+        uint64_t timer1Overflow() const;
+        uint64_t timer1Match(int channel) const; // UINT64_MAX = channel not in special event mode
+
+        // Timer2
+        bool timer2Running() const;
+        uint64_t timer2Prescale() const;
+        uint8_t timer2Count() const;
+        void timer2Rebase(uint8_t count);
+        uint64_t timer2Match() const; // Cycle of the next TMR2 = PR2 reset
+
+        // CCP PWM
+        void ccpPeriodStart(uint64_t cycle);
+        void ccpDutyEnd(int channel);
+
+        // EUSART
+        uint64_t uartBitCycles() const;
+        bool baudMatches(double baud) const;
+        void storeTxreg(uint8_t value);
+        void finishTransmit();
+        void startReceive();
+        void finishReceive();
+
+        // EEPROM
+        void storeEecon1(uint8_t value);
+        void finishEepromWrite();
+
+        uint8_t sfr_[256];
+        uint64_t cycle_;
+        uint64_t stopCycle_;
+        unsigned accessCost_;
+        void (*isr_)(void);
+        bool inIsr_;
+
+        uint64_t t0BaseCycle_;
+        uint16_t t0BaseCount_;
+        uint8_t tmr0hBuffer_;
+
+        uint64_t t1BaseCycle_;
+        uint16_t t1BaseCount_;
+        uint8_t tmr1hBuffer_;
+
+        uint64_t t2BaseCycle_;
+        uint8_t t2BaseCount_;
+        uint8_t t2Postscale_; // PR2 matches since the last TMR2IF
+
+        uint8_t ccpLevels_;   // PORTC bits of a CCP in PWM mode inside its duty
+        uint64_t ccpFall_[2]; // Duty end of the running period, UINT64_MAX = none
+
+        bool txPending_;
+        uint8_t txPendingValue_;
+        bool tsrBusy_;
+        uint8_t tsrValue_;
+        uint64_t tsrDone_;
+        uint32_t hostBaud_;
+        std::deque<uint8_t> hostQueue_;
+        bool rxBusy_;
+        uint8_t rxValue_;
+        double rxBaud_;
+        uint64_t rxStart_; // Start bit falling edge
+        uint64_t rxDone_;
+        int abdEdges_;     // Rising edges auto-baud has seen so far
+        double abdStart_;  // Cycle of the first one
+        std::deque<uint8_t> rxFifo_;
+        std::vector<UartByte> txLog_;
+
+        uint8_t eeprom_[256];
+        uint8_t eeUnlock_;
+        bool eeWriting_;
+        uint8_t eeAddress_;
+        uint8_t eeData_;
+        uint64_t eeDone_;
+        uint64_t eepromWrites_;
+        uint32_t eepromWritesAt_[256];
+
+        uint32_t stack_[32];
+
+        uint16_t ffMarker_;
+        uint8_t ffMask_; // 0 = fast-forward off
+        uint32_t passHash_;
+        bool passQuiet_;
+        uint64_t passIsrs_;
+        uint32_t lastHash_;
+        bool lastSteady_;
+        uint64_t ffCycles_;
+        uint64_t ffJumps_;
+
+        uint64_t isrCount_;
+        uint64_t isrCycles_;
+        uint64_t isrMaxCycles_;
+
+        std::multimap<uint64_t, std::function<void()>> events_;
+        std::vector<Peripheral *> peripherals_;
+        std::vector<std::function<void(const SfrAccess &)>> accessListeners_;
+        std::vector<std::function<void(const UartByte &)>> txListeners_;
+        std::vector<std::function<void()>> isrListeners_;
+    };
+}
+
+#endif
@@ -0,0 +1,336 @@
+#include "PwmCapture.h"
+
+#include "Hc595.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+// The Makefile compiles the firmware LED_UpdateConfig as LED_UpdateConfig_fw,
+// so the calls from the other modules land here
+void LED_UpdateConfig_fw(unsigned char *config);
+
+void LED_UpdateConfig(unsigned char *config)
+{
+    LED_UpdateConfig_fw(config);
+    if (sim::PwmCapture::current())
+        sim::PwmCapture::current()->configUpdated(config);
+}
+
+// Brightness of each level on the curve the firmware was built with and the
+// periods a new configuration takes to fade in (TLight.c)
+extern const unsigned char LED_LEVEL_BRIGHTNESS[];
+extern const unsigned char LED_FADE_PERIODS;
+
+namespace sim
+{
+    /* =======================================
+     *              CONSTANTS
+     * ======================================= */
+
+    // LED0 RD1, LED1 RD2, LED2 RD3, LED3 RC2 (CCP1), LED4 RC1 (CCP2), LED5 RD4 (TLight.c)
+    constexpr int kLedPort[kNumLeds] = {PortD, PortD, PortD, PortC, PortC, PortD};
+    constexpr uint8_t kLedPin[kNumLeds] = {0x02, 0x04, 0x08, 0x04, 0x02, 0x10};
+    constexpr uint64_t kBamPeriod = msToCycles(20); // TLight.c BAM_PERIOD_US
+
+    struct Transition
+    {
+        uint64_t cycle;
+        bool high; // Level from this cycle on
+    };
+
+    struct LevelStats
+    {
+        uint64_t time = 0;
+        uint64_t high = 0;
+        uint64_t periods = 0;
+        uint64_t periodTotal = 0;
+        int64_t offsetMin = INT64_MAX; // Rise-to-rise minus the nearest whole number of periods
+        int64_t offsetMax = INT64_MIN;
+        unsigned runts = 0;
+        unsigned glitches = 0;
+    };
+
+    int brightness(int level)
+    {
+        return LED_LEVEL_BRIGHTNESS[level];
+    }
+
+    // Does a 'high'/low pulse of 'width' belong to a brightness from level
+    // 'from' to 'to' on a PWM of 'resolution' slots per period? Dithered
+    // levels light the slot count below or above their brightness in each
+    // period, so pulses of either are accepted (and runs of periods with none
+    // or all); a crossfade goes through every width in between
+    bool pulseMatches(uint64_t width, int from, int to, bool high, double period, int resolution)
+    {
+        int perSlot = PwmCapture::kBrightnessSteps / resolution;
+        double step = period / resolution;
+        int below = std::min(brightness(from), brightness(to)) / perSlot;
+        int above = (std::max(brightness(from), brightness(to)) + perSlot - 1) / perSlot;
+        int fewest = high ? below : resolution - above; // Slots of this state per period
+        int most = high ? above : resolution - below;
+        if (most == 0)
+            return false;
+        long slots = std::lround((double)width / step);
+        if (most == resolution)
+            return slots >= std::max(fewest, 1); // Runs on into the next periods
+        return slots >= std::max(fewest, 1) && slots <= most;
+    }
+
+    uint8_t ledOutputs(const Pic18 &mcu)
+    {
+        if (Hc595Chain::current())
+            return (uint8_t)(Hc595Chain::current()->outputs() & ((1 << kNumLeds) - 1));
+        uint8_t leds = 0;
+        for (int led = 0; led < kNumLeds; led++)
+        {
+            if (mcu.outputs(kLedPort[led]) & kLedPin[led])
+                leds |= 1 << led;
+        }
+        return leds;
+    }
+
+    /* =======================================
+     *               CAPTURE
+     * ======================================= */
+
+    PwmCapture *PwmCapture::current_ = nullptr;
+
+    PwmCapture::PwmCapture(Pic18 &mcu)
+        : mcu_(mcu), writes_(0), chainMismatches_(0)
+    {
+        edges_.push_back({0, 0});
+        updates_.push_back({0, {0}}); // LED_Init
+        mcu.attach(this);
+        current_ = this;
+    }
+
+    PwmCapture::~PwmCapture()
+    {
+        if (current_ == this)
+            current_ = nullptr;
+    }
+
+    void PwmCapture::configUpdated(const uint8_t *config)
+    {
+        ConfigUpdate update = {mcu_.cycle(), {0}};
+        for (int led = 0; led < kNumLeds; led++)
+            update.levels[led] = std::min<uint8_t>(config[led], kLevels);
+        updates_.push_back(update);
+    }
+
+    void PwmCapture::onPinsChanged(Pic18 &mcu, int port)
+    {
+        if (port != PortC && port != PortD)
+            return;
+        writes_++;
+        const Hc595Chain *chain = Hc595Chain::current();
+        if (chain)
+        {
+            uint64_t outputs = chain->outputs();
+            for (int output = kNumLeds; output < chain->size(); output++)
+            {
+                if (((outputs >> output) & 1) != ((outputs >> (output % kNumLeds)) & 1))
+                {
+                    chainMismatches_++;
+                    break;
+                }
+            }
+        }
+        uint8_t leds = ledOutputs(mcu);
+        if (leds != edges_.back().leds)
+            edges_.push_back({mcu.cycle(), leds});
+    }
+
+    /* =======================================
+     *               METRICS
+     * ======================================= */
+
+    uint64_t PwmCapture::carrier(int led) const
+    {
+        // CCP outputs: one Timer2 period. Software LEDs: one slot per TMR2IF
+        // (TLight.c LED_Motor), kLevels slots per period. Chain: the BAM period
+        if (Hc595Chain::current())
+            return kBamPeriod;
+        if (kLedPort[led] == PortC && (mcu_.ccpPwmPins() & kLedPin[led]))
+            return mcu_.timer2Period();
+        return mcu_.timer2FlagPeriod() * kLevels;
+    }
+
+    bool PwmCapture::report(FILE *out) const
+    {
+        uint64_t end = mcu_.cycle();
+        uint64_t periods[kNumLeds];
+        for (int led = 0; led < kNumLeds; led++)
+            periods[led] = carrier(led);
+
+        // Software and CCP channels run at different periods: one entry per period
+        std::fprintf(out, "PWM:         %llu LED port writes, %zu LED_UpdateConfig calls, ",
+                     (unsigned long long)writes_, updates_.size() - 1);
+        bool listed = false;
+        for (int led = 0; led < kNumLeds; led++)
+        {
+            if (std::find(periods, periods + led, periods[led]) != periods + led)
+                continue;
+            std::fprintf(out, "%speriod %.3f ms (%.1f Hz) LED", listed ? ", " : "", cyclesToUs(periods[led]) / 1000.0,
+                         1e6 / cyclesToUs(periods[led]));
+            for (int other = led; other < kNumLeds; other++)
+            {
+                if (periods[other] == periods[led])
+                    std::fprintf(out, " %d", other);
+            }
+            listed = true;
+        }
+        std::fprintf(out, "\n");
+
+        // Supply load: LEDs lit at the same time (staggered phases keep the
+        // peak near the sum of the duties)
+        int peak = 0;
+        double litTime = 0;
+        for (size_t k = 0; k < edges_.size(); k++)
+        {
+            int lit = __builtin_popcount(edges_[k].leds);
+            uint64_t until = k + 1 < edges_.size() ? edges_[k + 1].cycle : end;
+            peak = std::max(peak, lit);
+            litTime += (double)lit * (until - edges_[k].cycle);
+        }
+        std::fprintf(out, "  lit at once: peak %d, average %.2f LEDs\n", peak, end ? litTime / end : 0.0);
+        const Hc595Chain *chain = Hc595Chain::current();
+        if (chain)
+            std::fprintf(out, "  chain: %d outputs, %llu latches, %llu with an output off its light%s\n", chain->size(),
+                         (unsigned long long)chain->latches(), (unsigned long long)chainMismatches_,
+                         chainMismatches_ ? "  <--" : "");
+        std::fprintf(out, "  LED level   time s    want     got    error  periods  avg ms  jitter us  runts  glitches\n");
+
+        // LED_UpdateConfig hands the new schedule over at the next software
+        // PWM period boundary (TLight.c LED_Motor), for the CCPs too, and it
+        // fades in over LED_FADE_PERIODS of them
+        uint64_t softwarePeriod = chain ? kBamPeriod : mcu_.timer2FlagPeriod() * kLevels;
+        uint64_t swapDelay = softwarePeriod * (1 + LED_FADE_PERIODS);
+
+        bool ok = chainMismatches_ == 0;
+        for (int led = 0; led < kNumLeds; led++)
+        {
+            // Waveform, period and configured level of this LED. The CCP
+            // resolves every brightness step, software LEDs whole slots
+            uint64_t period = periods[led];
+            bool ccp = kLedPort[led] == PortC && (mcu_.ccpPwmPins() & kLedPin[led]);
+            int resolution = ccp ? kBrightnessSteps : kLevels;
+            double step = (double)period / kLevels;
+            uint8_t bit = 1 << led;
+            std::vector<Transition> wave = {{0, false}};
+            for (const Edge &edge : edges_)
+            {
+                bool high = (edge.leds & bit) != 0;
+                if (high != wave.back().high)
+                    wave.push_back({edge.cycle, high});
+            }
+            // Every update may move the phase of the software LEDs (TLight.c
+            // stagger_phases), not only of those whose level changes: each one
+            // starts a new steady state
+            std::vector<std::pair<uint64_t, int>> levels;
+            for (const ConfigUpdate &update : updates_)
+                levels.push_back({update.cycle, update.levels[led]});
+
+            LevelStats stats[kLevels + 1];
+            for (size_t i = 0; i < levels.size(); i++)
+            {
+                uint64_t start = levels[i].first;
+                uint64_t stop = i + 1 < levels.size() ? levels[i + 1].first : end;
+                int level = levels[i].second;
+                LevelStats &entry = stats[level];
+
+                // Glitches: pulses ending within two periods of the fade
+                if (i > 0 && period && !chain)
+                {
+                    for (size_t k = 0; k + 1 < wave.size(); k++)
+                    {
+                        uint64_t pulseEnd = wave[k + 1].cycle;
+                        if (pulseEnd <= start || pulseEnd > start + swapDelay + 2 * period)
+                            continue;
+                        uint64_t width = pulseEnd - wave[k].cycle;
+                        if (!pulseMatches(width, levels[i - 1].second, level, wave[k].high, period, resolution))
+                            entry.glitches++;
+                    }
+                }
+
+                // Steady state: the swap, the fade and one period to settle, then whole periods
+                uint64_t from = start + swapDelay + period;
+                uint64_t to = stop;
+                if (to <= from)
+                    continue;
+                if (chain)
+                {
+                    // Every period repeats the same planes: whole periods from anywhere
+                    uint64_t whole = (to - from) / period;
+                    if (!whole)
+                        continue;
+                    to = from + whole * period;
+                    entry.periods += whole;
+                }
+                std::vector<uint64_t> rises;
+                for (const Transition &transition : wave)
+                {
+                    if (!chain && transition.high && transition.cycle >= from && transition.cycle < to)
+                        rises.push_back(transition.cycle);
+                }
+                if (rises.size() >= 2)
+                {
+                    from = rises.front();
+                    to = rises.back();
+                    for (size_t k = 1; k < rises.size(); k++)
+                    {
+                        uint64_t length = rises[k] - rises[k - 1];
+                        uint64_t whole = std::max<uint64_t>(1, (length + period / 2) / period);
+                        int64_t offset = (int64_t)length - (int64_t)(whole * period);
+                        entry.periods += whole;
+                        entry.periodTotal += length;
+                        entry.offsetMin = std::min(entry.offsetMin, offset);
+                        entry.offsetMax = std::max(entry.offsetMax, offset);
+                    }
+                }
+
+                entry.time += to - from;
+                for (size_t k = 0; k < wave.size(); k++)
+                {
+                    uint64_t pulseStart = std::max(wave[k].cycle, from);
+                    uint64_t pulseEnd = std::min(k + 1 < wave.size() ? wave[k + 1].cycle : end, to);
+                    if (pulseEnd <= pulseStart)
+                        continue;
+                    if (wave[k].high)
+                        entry.high += pulseEnd - pulseStart;
+                    // Runts: whole pulses inside the window only
+                    if (period && !chain && k + 1 < wave.size() && wave[k].cycle >= from && wave[k + 1].cycle <= to &&
+                        !pulseMatches(wave[k + 1].cycle - wave[k].cycle, level, level, wave[k].high, period, resolution))
+                        entry.runts++;
+                }
+            }
+
+            for (int level = 0; level <= kLevels; level++)
+            {
+                const LevelStats &entry = stats[level];
+                if (!entry.time && !entry.glitches)
+                    continue;
+                // Dithering settles to the exact brightness within one slot
+                // over the periods measured
+                double want = (double)brightness(level) / kBrightnessSteps;
+                double got = entry.time ? (double)entry.high / entry.time : 0;
+                double tolerance = 0.5 / kBrightnessSteps + 1.0 / kLevels / std::max<uint64_t>(entry.periods, 1);
+                bool dutyOk = !entry.time || std::fabs(got - want) <= tolerance;
+                bool jitterOk = entry.periods < 2 || entry.offsetMax - entry.offsetMin <= step;
+                ok = ok && dutyOk && jitterOk;
+
+                std::fprintf(out, "  %3d %5d %8.2f %6.1f%% %6.1f%% %+7.1f%% %8llu", led, level,
+                             cyclesToUs(entry.time) / 1e6, 100 * want, 100 * got, 100 * (got - want),
+                             (unsigned long long)entry.periods);
+                if (entry.periodTotal)
+                    std::fprintf(out, " %7.3f %10.1f", cyclesToUs(entry.periodTotal) / 1000.0 / entry.periods,
+                                 cyclesToUs(entry.offsetMax - entry.offsetMin));
+                else
+                    std::fprintf(out, " %7s %10s", "-", "-");
+                std::fprintf(out, " %6u %9u%s\n", entry.runts, entry.glitches, dutyOk && jitterOk ? "" : "  <--");
+            }
+        }
+        return ok;
+    }
+}
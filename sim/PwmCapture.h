@@ -0,0 +1,100 @@
+#ifndef SIM_PWMCAPTURE_H
+#define SIM_PWMCAPTURE_H
+
+#include "Pic18.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+/* =======================================
+ *      LED PWM CAPTURE AND METRICS
+ * ======================================= */
+/*
+ * Follows the six LED outputs (TLight.c: RD1, RD2, RD3, RC2 CCP1, RC1 CCP2,
+ * RD4) through every PORTC/PORTD/LATC/LATD/TRISC/TRISD write and CCP output
+ * edge and keeps each change with its cycle, plus every LED_UpdateConfig call
+ * (the host build hooks it, see the Makefile).
+ *
+ * METRICS, over all LEDs: the most lit at the same time and the average.
+ * Per LED and configured level, against the PWM period of that LED
+ * as set up in Timer2: one Timer2 period on the CCP pins, kLevels TMR2IF
+ * periods (one slot each) on the software ones:
+ * - Achieved duty over whole PWM periods vs the level's brightness on the
+ *   firmware curve (LED_LEVEL_BRIGHTNESS / kBrightnessSteps)
+ * - Period (rising edge to rising edge) average and peak-to-peak jitter; a
+ *   dithered level may skip periods, jitter is taken against the nearest
+ *   whole number of them
+ * - Runts: steady-state pulses more than half a slot off the widths the
+ *   brightness allows (one slot count, or the two around a dithered one); a
+ *   CCP slot is one brightness step
+ * - Glitches: pulses ending up to two periods after a LED_UpdateConfig has
+ *   faded in whose width is off every width from the old level to the new
+ *   one (e.g. pulses merged by a phase move). It takes effect at the next
+ *   software PWM period boundary, on the CCPs too, and fades in over
+ *   LED_FADE_PERIODS software periods: the steady state starts one period of
+ *   the LED's own after that
+ *
+ * With a 74HC595 chain (Hc595Chain::current()) the LEDs are its first six
+ * outputs, all on the 20ms bit-angle modulation period of TLight.c. A period
+ * holds up to one pulse per bit, so only the duty is checked, plus every
+ * latch showing light n % 6 on output n
+ */
+
+namespace sim
+{
+    constexpr int kNumLeds = 6;
+
+    // Bit n = LED n is lit
+    uint8_t ledOutputs(const Pic18 &mcu);
+
+    class PwmCapture : public Peripheral
+    {
+    public:
+        static constexpr int kLevels = 10;           // TLight.c MAX_TICS
+        static constexpr int kBrightnessSteps = 160; // TLight.c MAX_BRIGHTNESS
+
+        explicit PwmCapture(Pic18 &mcu);
+        ~PwmCapture() override;
+
+        // The capture LED_UpdateConfig reports to (the last one created)
+        static PwmCapture *current() { return current_; }
+        void configUpdated(const uint8_t *config);
+
+        uint64_t writes() const { return writes_; }
+        uint64_t chainMismatches() const { return chainMismatches_; }
+
+        // Prints the metrics up to now; FALSE when a level is further off its
+        // duty than dithering explains (half a brightness step plus one slot
+        // over the periods measured) or its period jitters by more than a slot
+        bool report(FILE *out) const;
+
+        // ---------- Peripheral ----------
+        void onPinsChanged(Pic18 &mcu, int port) override;
+
+    private:
+        struct Edge
+        {
+            uint64_t cycle;
+            uint8_t leds; // ledOutputs() from this cycle on
+        };
+
+        struct ConfigUpdate
+        {
+            uint64_t cycle;
+            uint8_t levels[kNumLeds];
+        };
+
+        uint64_t carrier(int led) const; // PWM period of the LED, from the Timer2/CCP setup
+
+        static PwmCapture *current_;
+
+        Pic18 &mcu_;
+        uint64_t writes_;
+        uint64_t chainMismatches_; // Latches with an output off its light
+        std::vector<Edge> edges_;
+        std::vector<ConfigUpdate> updates_;
+    };
+}
+
+#endif
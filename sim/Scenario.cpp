@@ -0,0 +1,409 @@
+#include "Scenario.h"
+#include "PwmCapture.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+
+namespace sim
+{
+    /* =======================================
+     *              CONSTANTS
+     * ======================================= */
+
+    constexpr uint64_t kTapReleaseMs = 100; // A tapped card leaves this long after its UID is read
+    constexpr uint64_t kDefaultKeyHoldMs = 100;
+    constexpr uint64_t kTimeDigitGapMs = 50;
+    constexpr uint64_t kTailMs = 1000; // Silence after the last step of a run
+
+    constexpr unsigned kMaxLightPeriod = 32; // Samples, one per interrupt
+    constexpr size_t kLightWindow = 3 * kMaxLightPeriod;
+    constexpr int kLedsPerUser = 6;
+
+    const char *const kKindNames[] = {"card", "key", "serial", "time"};
+    const char *const kChannelNames[] = {"lights", "lcd first", "lcd done", "serial first", "serial done"};
+
+    // Histogram bucket upper bounds (ms)
+    const double kBuckets[] = {0.1, 0.2, 0.5, 1, 2, 5, 10, 20, 50, 100, 200, 500, 1000, 2000, 5000};
+    constexpr int kNumBuckets = sizeof(kBuckets) / sizeof(kBuckets[0]) + 1;
+    constexpr int kBarWidth = 40;
+
+    std::string unescape(const std::string &text)
+    {
+        std::string result;
+        for (size_t i = 0; i < text.size(); i++)
+        {
+            if (text[i] == '\\' && i + 1 < text.size() && text[i + 1] == 'e')
+            {
+                result += '\x1b';
+                i++;
+            }
+            else
+            {
+                result += text[i];
+            }
+        }
+        return result;
+    }
+
+    double percentile(const std::vector<double> &sorted, double fraction)
+    {
+        size_t rank = (size_t)std::ceil(fraction * sorted.size());
+        return sorted[rank > 0 ? rank - 1 : 0];
+    }
+
+    /* =======================================
+     *               SCRIPT
+     * ======================================= */
+
+    Scenario::Scenario(Pic18 &mcu, Mfrc522 &rfid, KeypadMatrix &keypad, Hd44780 &lcd)
+        : mcu_(mcu), rfid_(rfid), keypad_(keypad), lcd_(lcd), repeat_(0), endCycle_(0)
+    {
+        mcu.onInterruptReturn([this]
+                              { sampleLights(); });
+        lcd.onChange([this]
+                     { respond(LcdFirst); });
+        mcu.onTransmit([this](const UartByte &)
+                       { respond(SerialFirst); });
+        rfid.onDetection([this](const Mfrc522::Detection &detection)
+                         { cardRead(detection.card); });
+    }
+
+    bool Scenario::load(const char *path, std::string &error)
+    {
+        std::ifstream file(path);
+        if (!file)
+        {
+            error = std::string("cannot open ") + path;
+            return false;
+        }
+        return parse(file, path, error);
+    }
+
+    bool Scenario::parse(std::istream &script, const std::string &name, std::string &error)
+    {
+        path_ = name;
+        std::string line;
+        for (int number = 1; std::getline(script, line); number++)
+        {
+            if (!line.empty() && line.back() == '\r')
+                line.pop_back();
+            std::istringstream in(line);
+            std::string first;
+            if (!(in >> first) || first[0] == '#')
+                continue; // Blank line or comment
+
+            std::string where = name + ":" + std::to_string(number) + ": ";
+            if (first == "eeprom")
+            {
+                std::string address, value;
+                if (!(in >> address >> value))
+                {
+                    error = where + "eeprom ADDR BYTE...";
+                    return false;
+                }
+                unsigned next = std::strtoul(address.c_str(), nullptr, 16);
+                do
+                    eeprom_.push_back({(uint8_t)next++, (uint8_t)std::strtoul(value.c_str(), nullptr, 16)});
+                while (in >> value);
+                continue;
+            }
+            if (first == "config")
+            {
+                unsigned user;
+                unsigned levels[kLedsPerUser];
+                if (!(in >> user))
+                {
+                    error = where + "config USER L0 L1 L2 L3 L4 L5";
+                    return false;
+                }
+                for (int led = 0; led < kLedsPerUser; led++)
+                {
+                    if (!(in >> levels[led]) || levels[led] > 10)
+                    {
+                        error = where + "config USER L0 L1 L2 L3 L4 L5 (0-10)";
+                        return false;
+                    }
+                    eeprom_.push_back({(uint8_t)(user * kLedsPerUser + led), (uint8_t)levels[led]});
+                }
+                continue;
+            }
+
+            Step step = {std::strtoull(first.c_str(), nullptr, 10), Card, "", 0};
+            std::string command;
+            if (!(in >> command))
+            {
+                error = where + "missing command";
+                return false;
+            }
+            if (command == "card")
+            {
+                Mfrc522::Card card;
+                if (!(in >> step.text) || !Mfrc522::parseUid(step.text, card))
+                {
+                    error = where + "card UID (8 hex digits) [HOLD_MS]";
+                    return false;
+                }
+                in >> step.holdMs;
+            }
+            else if (command == "key")
+            {
+                step.kind = Key;
+                step.holdMs = kDefaultKeyHoldMs;
+                if (!(in >> step.text) || step.text.size() != 1 || !KeypadMatrix::isKey(step.text[0]))
+                {
+                    error = where + "key K (0-9 * #) [HOLD_MS]";
+                    return false;
+                }
+                in >> step.holdMs;
+            }
+            else if (command == "serial")
+            {
+                step.kind = Serial;
+                std::getline(in >> std::ws, step.text);
+                step.text = unescape(step.text);
+                if (step.text.empty())
+                {
+                    error = where + "serial TEXT";
+                    return false;
+                }
+            }
+            else if (command == "time")
+            {
+                step.kind = Time;
+                std::string time;
+                in >> time;
+                if (time.size() != 5 || time[2] != ':' || !std::all_of(time.begin(), time.end(), [](char c)
+                                                                       { return c == ':' || (c >= '0' && c <= '9'); }))
+                {
+                    error = where + "time HH:MM";
+                    return false;
+                }
+                step.text = time.substr(0, 2) + time.substr(3, 2);
+            }
+            else
+            {
+                error = where + "unknown command '" + command + "'";
+                return false;
+            }
+            steps_.push_back(step);
+        }
+        return true;
+    }
+
+    void Scenario::schedule(unsigned repeat)
+    {
+        for (const auto &entry : eeprom_)
+            mcu_.setEeprom(entry.first, entry.second);
+
+        uint64_t lengthMs = 0;
+        for (const Step &step : steps_)
+            lengthMs = std::max(lengthMs, step.ms + step.holdMs);
+        lengthMs += kTailMs;
+
+        repeat_ = repeat;
+        for (unsigned run = 0; run < repeat; run++)
+        {
+            for (const Step &step : steps_)
+                scheduleStep(step, msToCycles(run * lengthMs));
+        }
+        endCycle_ = msToCycles(repeat * lengthMs);
+    }
+
+    void Scenario::scheduleStep(const Step &step, uint64_t offset)
+    {
+        uint64_t at = offset + msToCycles(step.ms);
+        switch (step.kind)
+        {
+        case Card:
+        {
+            Mfrc522::Card card;
+            Mfrc522::parseUid(step.text, card);
+            mcu_.at(at, [this, card, step]
+                    {
+                stimulus(Card);
+                if (!step.holdMs)
+                    taps_.push_back(uidKey(card)); });
+            rfid_.scheduleCard(card, at, step.holdMs ? at + msToCycles(step.holdMs) : 0);
+            break;
+        }
+        case Key:
+            mcu_.at(at, [this]
+                    { stimulus(Key); });
+            keypad_.schedulePress(step.text[0], at, msToCycles(step.holdMs));
+            break;
+        case Serial:
+        {
+            std::string text = step.text;
+            mcu_.at(at, [this, text]
+                    {
+                stimulus(Serial);
+                mcu_.hostSend(text.c_str()); });
+            break;
+        }
+        case Time:
+        {
+            mcu_.at(at, [this]
+                    { mcu_.hostSend('3'); });
+            for (size_t i = 0; i < step.text.size(); i++)
+            {
+                char digit = step.text[i];
+                bool last = i + 1 == step.text.size();
+                mcu_.at(at + msToCycles((i + 1) * kTimeDigitGapMs), [this, digit, last]
+                        {
+                    if (last)
+                        stimulus(Time);
+                    mcu_.hostSend((uint8_t)digit); });
+            }
+            break;
+        }
+        default:
+            break;
+        }
+    }
+
+    void Scenario::cardRead(const Mfrc522::Card &card)
+    {
+        auto tap = std::find(taps_.begin(), taps_.end(), uidKey(card));
+        if (tap == taps_.end())
+            return;
+        taps_.erase(tap);
+        mcu_.at(mcu_.cycle() + msToCycles(kTapReleaseMs), [this, card]
+                { rfid_.leaveField(card); });
+    }
+
+    /* =======================================
+     *              RESPONSES
+     * ======================================= */
+
+    void Scenario::stimulus(Kind kind)
+    {
+        Stimulus entry = {kind, mcu_.cycle(), lightPeriod(), lightSamples_.size(), {0}};
+        stimuli_.push_back(entry);
+    }
+
+    void Scenario::respond(Channel channel)
+    {
+        if (stimuli_.empty())
+            return;
+        Stimulus &current = stimuli_.back();
+        uint64_t latency = std::max<uint64_t>(mcu_.cycle() - current.cycle, 1);
+        if (current.response[channel] == 0)
+            current.response[channel] = latency;
+        if (channel == LcdFirst || channel == SerialFirst)
+            current.response[channel + 1] = latency; // ... done: the last one wins
+    }
+
+    void Scenario::sampleLights()
+    {
+        uint8_t sample = ledOutputs(mcu_);
+        lightSamples_.push_back(sample);
+
+        if (stimuli_.empty() || stimuli_.back().response[Lights] != 0)
+            return;
+        const Stimulus &current = stimuli_.back();
+        size_t index = lightSamples_.size() - 1;
+        size_t period = current.lightPeriod ? current.lightPeriod : 1;
+        if (index >= current.lightSample && index >= period && sample != lightSamples_[index - period])
+            respond(Lights);
+    }
+
+    unsigned Scenario::lightPeriod() const
+    {
+        // Smallest period that explains the whole window (a short window would
+        // take a few equal samples inside a PWM period for a period of 1)
+        size_t count = lightSamples_.size();
+        if (count < kLightWindow)
+            return 0;
+        for (unsigned period = 1; period <= kMaxLightPeriod; period++)
+        {
+            bool periodic = true;
+            for (size_t i = count - kLightWindow + period; i < count && periodic; i++)
+                periodic = lightSamples_[i] == lightSamples_[i - period];
+            if (periodic)
+                return period;
+        }
+        return 0;
+    }
+
+    /* =======================================
+     *               REPORT
+     * ======================================= */
+
+    Scenario::LatencyTable Scenario::latencies() const
+    {
+        LatencyTable table;
+        for (const Stimulus &entry : stimuli_)
+        {
+            for (int channel = 0; channel < kNumChannels; channel++)
+            {
+                if (entry.response[channel])
+                    table.samples[entry.kind][channel].push_back(entry.response[channel]);
+                else
+                    table.missed[entry.kind][channel]++;
+            }
+        }
+        return table;
+    }
+
+    void Scenario::report(FILE *out) const
+    {
+        std::fprintf(out, "\nScenario:    %s x %u, %zu stimuli\n", path_.c_str(), repeat_, stimuli_.size());
+        latencies().print(out);
+    }
+
+    void Scenario::LatencyTable::merge(const LatencyTable &other)
+    {
+        for (int kind = 0; kind < kNumKinds; kind++)
+        {
+            for (int channel = 0; channel < kNumChannels; channel++)
+            {
+                samples[kind][channel].insert(samples[kind][channel].end(), other.samples[kind][channel].begin(),
+                                              other.samples[kind][channel].end());
+                missed[kind][channel] += other.missed[kind][channel];
+            }
+        }
+    }
+
+    void Scenario::LatencyTable::print(FILE *out) const
+    {
+        std::fprintf(out, "%-24s %5s %9s %9s %9s %7s\n", "latency (ms)", "n", "p50", "p99", "max", "missed");
+
+        for (int kind = 0; kind < kNumKinds; kind++)
+        {
+            for (int channel = 0; channel < kNumChannels; channel++)
+            {
+                if (samples[kind][channel].empty())
+                    continue;
+                std::vector<double> sorted;
+                for (uint64_t cycles : samples[kind][channel])
+                    sorted.push_back(cyclesToUs(cycles) / 1000.0);
+                std::sort(sorted.begin(), sorted.end());
+
+                std::string name = std::string(kKindNames[kind]) + " -> " + kChannelNames[channel];
+                std::fprintf(out, "%-24s %5zu %9.2f %9.2f %9.2f %7llu\n", name.c_str(), sorted.size(),
+                             percentile(sorted, 0.50), percentile(sorted, 0.99), sorted.back(),
+                             (unsigned long long)missed[kind][channel]);
+
+                size_t counts[kNumBuckets] = {0};
+                for (double value : sorted)
+                    counts[std::upper_bound(kBuckets, kBuckets + kNumBuckets - 1, value) - kBuckets]++;
+                size_t most = *std::max_element(counts, counts + kNumBuckets);
+                for (int bucket = 0; bucket < kNumBuckets; bucket++)
+                {
+                    if (!counts[bucket])
+                        continue;
+                    char bound[16];
+                    if (bucket < kNumBuckets - 1)
+                        std::snprintf(bound, sizeof(bound), "< %g", kBuckets[bucket]);
+                    else
+                        std::snprintf(bound, sizeof(bound), ">= %g", kBuckets[bucket - 1]);
+                    int width = (int)((counts[bucket] * kBarWidth + most - 1) / most);
+                    std::fprintf(out, "    %9s |%s %zu\n", bound, std::string(width, '#').c_str(), counts[bucket]);
+                }
+            }
+        }
+    }
+}
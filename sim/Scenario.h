@@ -0,0 +1,133 @@
+#ifndef SIM_SCENARIO_H
+#define SIM_SCENARIO_H
+
+#include "Hd44780.h"
+#include "Keypad.h"
+#include "Mfrc522.h"
+#include "Pic18.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <istream>
+#include <string>
+#include <vector>
+
+/* =======================================
+ *        SCENARIO REPLAY + LATENCY
+ * ======================================= */
+/*
+ * Replays a timestamped script against the firmware and measures how long
+ * each stimulus takes to show up on the outputs.
+ *
+ * SCRIPT (one command per line, lines starting with '#' are comments):
+ *   eeprom ADDR BYTE...       set data EEPROM bytes before reset (hex)
+ *   config USER L0 ... L5     store a user light config (0-10) in EEPROM
+ *   MS card UID [HOLD_MS]     card enters the RC522 field for HOLD_MS; without it
+ *                             the card is tapped: it leaves 100 ms after its UID is read
+ *   MS key K [HOLD_MS]        keypad key 0-9 * # pressed (default hold 100 ms)
+ *   MS serial TEXT            PC types TEXT (rest of the line, \e = ESC)
+ *   MS time HH:MM             PC sets the time: '3', then the digits 50 ms apart
+ *
+ * The stimulus instant is the card entering the field, the key press, the
+ * first serial byte leaving the PC, or the last time digit.
+ *
+ * RESPONSES (first event after the stimulus, until the next stimulus):
+ * - lights: first LED pin pattern, sampled after every interrupt,
+ *   that differs from the pattern one PWM period earlier (the period is
+ *   detected from the samples before the stimulus)
+ * - lcd: first and last DDRAM cell that changes
+ * - serial: first and last byte received by the PC
+ */
+
+namespace sim
+{
+    class Scenario
+    {
+    public:
+        enum Kind
+        {
+            Card,
+            Key,
+            Serial,
+            Time,
+            kNumKinds
+        };
+
+        enum Channel
+        {
+            Lights,
+            LcdFirst,
+            LcdLast,
+            SerialFirst,
+            SerialLast,
+            kNumChannels
+        };
+
+        // Latencies in cycles, mergeable across runs
+        struct LatencyTable
+        {
+            std::vector<uint64_t> samples[kNumKinds][kNumChannels];
+            uint64_t missed[kNumKinds][kNumChannels] = {};
+
+            void merge(const LatencyTable &other);
+            void print(FILE *out) const;
+        };
+
+        Scenario(Pic18 &mcu, Mfrc522 &rfid, KeypadMatrix &keypad, Hd44780 &lcd);
+
+        // Return FALSE and fill 'error' on a syntax error. 'name' prefixes the
+        // error messages
+        bool load(const char *path, std::string &error);
+        bool parse(std::istream &in, const std::string &name, std::string &error);
+
+        // Sets up the EEPROM and schedules 'repeat' back to back runs of the script
+        void schedule(unsigned repeat);
+        uint64_t endCycle() const { return endCycle_; }
+
+        LatencyTable latencies() const;
+        void report(FILE *out) const;
+
+    private:
+
+        struct Step
+        {
+            uint64_t ms;
+            Kind kind;
+            std::string text; // UID, key, serial text or HHMM
+            uint64_t holdMs; // Card: 0 = tap
+        };
+
+        struct Stimulus
+        {
+            Kind kind;
+            uint64_t cycle;
+            unsigned lightPeriod; // Samples, 0 = LEDs were not periodic
+            size_t lightSample;   // Index of the first sample after the stimulus
+            uint64_t response[kNumChannels]; // 0 = no response
+        };
+
+        void scheduleStep(const Step &step, uint64_t offset);
+        void stimulus(Kind kind);
+        void respond(Channel channel);
+        void sampleLights();
+        void cardRead(const Mfrc522::Card &card);
+        unsigned lightPeriod() const;
+
+        Pic18 &mcu_;
+        Mfrc522 &rfid_;
+        KeypadMatrix &keypad_;
+        Hd44780 &lcd_;
+
+        std::string path_;
+        std::vector<Step> steps_;
+        std::vector<std::pair<uint8_t, uint8_t>> eeprom_;
+        unsigned repeat_;
+        uint64_t endCycle_;
+
+        std::vector<uint32_t> taps_; // Tapped cards not read yet
+        std::vector<Stimulus> stimuli_;
+        std::vector<uint8_t> lightSamples_;
+    };
+}
+
+#endif
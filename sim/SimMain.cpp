@@ -0,0 +1,436 @@
+#include "Hc595.h"
+#include "Hd44780.h"
+#include "Keypad.h"
+#include "Mfrc522.h"
+#include "OpCounters.h"
+#include "Pic18.h"
+#include "PwmCapture.h"
+#include "Scenario.h"
+#include "VcdTrace.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+/* =======================================
+ *        HOST RUNNER (p2a_sim)
+ * ======================================= */
+/*
+ * Runs the unchanged firmware (main.c loop + RSI_High) on the simulated
+ * PIC18F4321 for a given virtual time, prints what it sent through the
+ * serial port and a timing summary in simulated cycles:
+ * - RSI_High cost per interrupt
+ * - Main loop period, measured on the LATE2 toggle done once per pass
+ * - RFID: card-tap-to-UID latency and SPI cost of each scripted card
+ * - LCD: rendered 2x16 text and busy-flag protocol counters
+ * - PWM (--pwm): duty, period jitter and glitches of each LED and level,
+ *   exit status 1 when a level is off its duty or jitters
+ *
+ * --lcd-bench runs only TiInit, LED_Init (the Timer2 interrupt ticks TTimer on
+ * the pins backend) and LCD_Init, and times the LCD_Write* calls,
+ * then checks the screen against the README layout.
+ *
+ * --vcd dumps the RFID SPI, LCD bus, LED and loop marker pins for GTKWave.
+ *
+ * --scenario replays a script (see Scenario.h) --repeat times and prints
+ * stimulus-to-output latency histograms; the run lasts as long as the script.
+ *
+ * --ops counts the SFR, SPI, EEPROM, UART and LCD traffic of each API call
+ * (see OpCounters.h); --budgets checks it against a budget file and exits 1
+ * when an operation runs over.
+ *
+ * --fast-forward jumps over idle main loop passes (see Pic18.h), so hours of
+ * HORA rollovers and Tics wraparounds run in seconds. The main loop figures
+ * then only count the passes that ran.
+ */
+
+void firmware_main(void);
+void RSI_High(void);
+void TiInit(void);
+void LED_Init(void);
+void LCD_Init(void);
+void LCD_WriteNoUserInfo(void);
+void LCD_WriteUserInfo(unsigned char last_uid_char, const unsigned char *light_config);
+void LCD_UpdateTime(unsigned char hour, unsigned char minute);
+void LCD_UpdateLightConfig(const unsigned char *light_config);
+
+using namespace sim;
+
+namespace
+{
+    constexpr uint16_t kLATE = kLATA + PortE;
+    constexpr uint8_t kLoopMarker = 0x04; // LATE2
+
+    struct LoopStats
+    {
+        uint64_t passes = 0;
+        uint64_t last = 0;
+        uint64_t total = 0;
+        uint64_t max = 0;
+        uint64_t skipped = 0; // Fast-forwarded cycles at the last pass
+        uint8_t marker = 0;
+    };
+
+    struct LcdCall
+    {
+        const char *name;
+        uint64_t cycles;
+        uint64_t pulses;
+        uint64_t busyReads;
+    };
+
+    Hd44780 *benchLcd;
+    std::vector<LcdCall> lcdCalls;
+
+    // Layout from the README: "F 16:30 1-0 2-3 3-3 4-0 5-9 6-A"
+    const unsigned char kBenchConfig[6] = {0, 3, 3, 0, 9, 10};
+    const char *const kBenchScreen[Hd44780::kRows] = {"F 16:30 1-0 2-3 ", "3-3 4-0 5-9 6-A "};
+
+    template <typename Call>
+    void timeLcdCall(const char *name, Call call)
+    {
+        Pic18 &mcu = Pic18::instance();
+        LcdCall result = {name, mcu.cycle(), benchLcd->enablePulses(), benchLcd->busyReads()};
+        call();
+        result.cycles = mcu.cycle() - result.cycles;
+        result.pulses = benchLcd->enablePulses() - result.pulses;
+        result.busyReads = benchLcd->busyReads() - result.busyReads;
+        lcdCalls.push_back(result);
+    }
+
+    void lcdBench(void)
+    {
+        TiInit();
+        LED_Init();
+        LCD_Init();
+        timeLcdCall("LCD_WriteNoUserInfo", []
+                    { LCD_WriteNoUserInfo(); });
+        timeLcdCall("LCD_UpdateTime", []
+                    { LCD_UpdateTime(0x16, 0x30); }); // BCD, as THora keeps it
+        timeLcdCall("LCD_WriteUserInfo", []
+                    { LCD_WriteUserInfo('F', kBenchConfig); });
+        timeLcdCall("LCD_UpdateLightConfig", []
+                    { LCD_UpdateLightConfig(kBenchConfig); });
+    }
+
+    void printLcd(const Hd44780 &lcd)
+    {
+        std::printf("LCD:         %llu instructions, %llu characters, %llu busy-flag reads (%llu busy), "
+                    "%llu writes while busy, %llu short E pulses\n",
+                    (unsigned long long)lcd.instructions(), (unsigned long long)lcd.dataWrites(),
+                    (unsigned long long)lcd.busyReads(), (unsigned long long)lcd.busyReadsWhileBusy(),
+                    (unsigned long long)lcd.writesWhileBusy(), (unsigned long long)lcd.shortPulses());
+        for (int row = 0; row < Hd44780::kRows; row++)
+            std::printf("             |%s|%s\n", lcd.line(row).c_str(), lcd.displayOn() ? "" : " (display off)");
+    }
+
+    void usage(const char *program)
+    {
+        std::fprintf(stderr,
+                     "usage: %s [--seconds S] [--send MS:TEXT]... [--card MS:UID[:HOLD_MS]]...\n"
+                     "          [--host-baud BAUD] [--access-cost CYCLES] [--lcd-bench]\n"
+                     "          [--scenario FILE [--repeat N]] [--quiet] [--pwm]\n"
+                     "          [--vcd FILE [--vcd-window FROM_MS:TO_MS]]\n"
+                     "  --seconds      simulated time to run (default 2)\n"
+                     "  --send         PC sends TEXT at MS milliseconds (\\e = ESC)\n"
+                     "  --card         card with UID (8 hex digits) enters the RC522 field at MS,\n"
+                     "                 and leaves it after HOLD_MS (default: stays)\n"
+                     "  --host-baud    PC terminal baud rate (default: always matches the PIC)\n"
+                     "  --access-cost  cycles charged per SFR access (default 4)\n"
+                     "  --lcd-bench    time the LCD_Write* calls and check the screen layout\n"
+                     "  --scenario     replay FILE and report end-to-end latencies\n"
+                     "  --repeat       back to back runs of the scenario (default 1)\n"
+                     "  --quiet        do not print what the PIC sent\n"
+                     "  --pwm          LED duty/jitter/glitch report, exit 1 on a duty or jitter error\n"
+                     "  --vcd          write SPI, LCD, LED and loop marker waveforms to FILE (GTKWave)\n"
+                     "  --vcd-window   only dump from FROM_MS to TO_MS\n"
+                     "  --fast-forward jump the clock over idle main loop passes\n"
+                     "  --ops          SFR/SPI/EEPROM/UART/LCD traffic per API call\n"
+                     "  --budgets      check --ops against the budgets in FILE, exit 1 when over\n",
+                     program);
+        std::exit(1);
+    }
+
+    std::string unescape(const char *text)
+    {
+        std::string result;
+        for (; *text; text++)
+        {
+            if (text[0] == '\\' && text[1] == 'e')
+            {
+                result += '\x1b';
+                text++;
+            }
+            else
+            {
+                result += *text;
+            }
+        }
+        return result;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    double seconds = 2.0;
+    bool bench = false;
+    bool quiet = false;
+    bool pwmReport = false;
+    bool opReport = false;
+    const char *budgetsPath = nullptr;
+    const char *scenarioPath = nullptr;
+    const char *vcdPath = nullptr;
+    uint64_t vcdFrom = 0;
+    uint64_t vcdTo = 0;
+    unsigned repeat = 1;
+    Pic18 &mcu = Pic18::instance();
+    Mfrc522 rfid(mcu);
+    Hd44780 lcd(mcu);
+    KeypadMatrix keypad(mcu);
+#ifdef SIM_HC595
+    Hc595Chain chain(mcu, SIM_HC595); // Before the capture: it latches first
+#endif
+    PwmCapture pwm(mcu);
+    Scenario scenario(mcu, rfid, keypad, lcd);
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (!std::strcmp(argv[i], "--seconds") && i + 1 < argc)
+        {
+            seconds = std::atof(argv[++i]);
+        }
+        else if (!std::strcmp(argv[i], "--send") && i + 1 < argc)
+        {
+            const char *arg = argv[++i];
+            const char *colon = std::strchr(arg, ':');
+            if (!colon)
+                usage(argv[0]);
+            std::string text = unescape(colon + 1);
+            mcu.at(msToCycles(std::atoll(arg)), [text]
+                   { Pic18::instance().hostSend(text.c_str()); });
+        }
+        else if (!std::strcmp(argv[i], "--card") && i + 1 < argc)
+        {
+            const char *arg = argv[++i];
+            const char *colon = std::strchr(arg, ':');
+            Mfrc522::Card card;
+            if (!colon || !Mfrc522::parseUid(std::string(colon + 1, 8), card))
+                usage(argv[0]);
+            uint64_t enter = msToCycles(std::atoll(arg));
+            const char *hold = std::strchr(colon + 1, ':');
+            rfid.scheduleCard(card, enter, hold ? enter + msToCycles(std::atoll(hold + 1)) : 0);
+        }
+        else if (!std::strcmp(argv[i], "--host-baud") && i + 1 < argc)
+        {
+            mcu.setHostBaud(std::atoi(argv[++i]));
+        }
+        else if (!std::strcmp(argv[i], "--access-cost") && i + 1 < argc)
+        {
+            mcu.setAccessCost(std::atoi(argv[++i]));
+        }
+        else if (!std::strcmp(argv[i], "--lcd-bench"))
+        {
+            bench = true;
+        }
+        else if (!std::strcmp(argv[i], "--scenario") && i + 1 < argc)
+        {
+            scenarioPath = argv[++i];
+        }
+        else if (!std::strcmp(argv[i], "--repeat") && i + 1 < argc)
+        {
+            repeat = std::atoi(argv[++i]);
+        }
+        else if (!std::strcmp(argv[i], "--quiet"))
+        {
+            quiet = true;
+        }
+        else if (!std::strcmp(argv[i], "--fast-forward"))
+        {
+            mcu.enableFastForward(kLATE, kLoopMarker);
+        }
+        else if (!std::strcmp(argv[i], "--ops"))
+        {
+            opReport = true;
+        }
+        else if (!std::strcmp(argv[i], "--budgets") && i + 1 < argc)
+        {
+            budgetsPath = argv[++i];
+        }
+        else if (!std::strcmp(argv[i], "--pwm"))
+        {
+            pwmReport = true;
+        }
+        else if (!std::strcmp(argv[i], "--vcd") && i + 1 < argc)
+        {
+            vcdPath = argv[++i];
+        }
+        else if (!std::strcmp(argv[i], "--vcd-window") && i + 1 < argc)
+        {
+            const char *arg = argv[++i];
+            const char *colon = std::strchr(arg, ':');
+            if (!colon)
+                usage(argv[0]);
+            vcdFrom = msToCycles(std::atoll(arg));
+            vcdTo = msToCycles(std::atoll(colon + 1));
+        }
+        else
+        {
+            usage(argv[0]);
+        }
+    }
+
+    std::unique_ptr<OpCounters> ops;
+    if (opReport || budgetsPath)
+    {
+        ops.reset(new OpCounters(mcu, rfid, lcd));
+        std::string error;
+        if (budgetsPath && !ops->loadBudgets(budgetsPath, error))
+        {
+            std::fprintf(stderr, "%s\n", error.c_str());
+            return 1;
+        }
+    }
+
+    // Created last: it samples the pins after the other devices have reacted
+    FILE *vcdFile = nullptr;
+    std::unique_ptr<VcdTrace> vcd;
+    if (vcdPath)
+    {
+        vcdFile = std::fopen(vcdPath, "w");
+        if (!vcdFile)
+        {
+            std::perror(vcdPath);
+            return 1;
+        }
+        vcd.reset(new VcdTrace(mcu, vcdFile, vcdFrom, vcdTo));
+    }
+
+    if (bench)
+    {
+        benchLcd = &lcd;
+        mcu.setInterruptHandler(RSI_High);
+        mcu.run(lcdBench, UINT64_MAX);
+        if (vcd)
+        {
+            vcd->finish();
+            std::fclose(vcdFile);
+        }
+        for (const LcdCall &call : lcdCalls)
+        {
+            std::printf("%-22s %8.1f us, %4llu E pulses, %4llu busy-flag reads\n", call.name,
+                        cyclesToUs(call.cycles), (unsigned long long)call.pulses, (unsigned long long)call.busyReads);
+        }
+        printLcd(lcd);
+
+        bool layoutOk = lcd.displayOn();
+        for (int row = 0; row < Hd44780::kRows; row++)
+            layoutOk = layoutOk && lcd.line(row) == kBenchScreen[row];
+        std::printf("Layout:      %s (expected |%s|%s|)\n", layoutOk ? "OK" : "MISMATCH", kBenchScreen[0], kBenchScreen[1]);
+        bool budgetOk = true;
+        if (ops)
+        {
+            ops->report(stdout);
+            budgetOk = !budgetsPath || ops->checkBudgets(stdout);
+        }
+        return layoutOk && budgetOk ? 0 : 1;
+    }
+
+    if (scenarioPath)
+    {
+        std::string error;
+        if (!scenario.load(scenarioPath, error))
+        {
+            std::fprintf(stderr, "%s\n", error.c_str());
+            return 1;
+        }
+        scenario.schedule(repeat);
+        seconds = (double)scenario.endCycle() / kFcy;
+    }
+
+    LoopStats loop;
+    mcu.onAccess([&loop, &mcu](const SfrAccess &access)
+                 {
+        if (!access.write || access.inIsr || access.address != kLATE)
+            return;
+        uint8_t marker = access.value & kLoopMarker;
+        if (marker == loop.marker)
+            return;
+        loop.marker = marker;
+        if (loop.passes > 0)
+        {
+            uint64_t period = access.cycle - loop.last - (mcu.fastForwardCycles() - loop.skipped);
+            loop.total += period;
+            if (period > loop.max)
+                loop.max = period;
+        }
+        loop.last = access.cycle;
+        loop.skipped = mcu.fastForwardCycles();
+        loop.passes++; });
+
+    mcu.setInterruptHandler(RSI_High);
+    uint64_t end = (uint64_t)(seconds * kFcy);
+    mcu.run(firmware_main, end);
+    if (vcd)
+    {
+        vcd->finish();
+        std::fclose(vcdFile);
+    }
+
+    if (!quiet)
+    {
+        for (const UartByte &byte : mcu.txLog())
+            std::putchar(byte.framingOk ? byte.value : '?');
+    }
+
+    std::printf("\n\n--- %.3f s simulated (%llu cycles) ---\n", seconds, (unsigned long long)mcu.cycle());
+    if (mcu.interruptCount() > 0)
+    {
+        std::printf("Interrupts:  %llu, RSI_High avg %.1f us, max %.1f us, %.2f%% of CPU\n",
+                    (unsigned long long)mcu.interruptCount(),
+                    cyclesToUs(mcu.interruptCycles()) / mcu.interruptCount(),
+                    cyclesToUs(mcu.interruptMaxCycles()),
+                    100.0 * mcu.interruptCycles() / mcu.cycle());
+    }
+    if (loop.passes > 1)
+    {
+        std::printf("Main loop:   %llu passes, avg %.1f us, max %.1f us\n",
+                    (unsigned long long)loop.passes,
+                    cyclesToUs(loop.total) / (loop.passes - 1),
+                    cyclesToUs(loop.max));
+    }
+    if (mcu.fastForwardJumps() > 0)
+    {
+        std::printf("Fast-forward: %llu jumps over %.1f%% of the run\n", (unsigned long long)mcu.fastForwardJumps(),
+                    100.0 * mcu.fastForwardCycles() / mcu.cycle());
+    }
+    std::printf("UART:        %zu bytes at %.0f baud\n", mcu.txLog().size(), mcu.uartBaud());
+    std::printf("EEPROM:      %llu writes\n", (unsigned long long)mcu.eepromWrites());
+    std::printf("RFID:        %llu frames sent, %llu UID reads, %llu register accesses, %llu SCK edges\n",
+                (unsigned long long)rfid.frames(), (unsigned long long)rfid.uidReads(),
+                (unsigned long long)rfid.transactions(), (unsigned long long)rfid.sckEdges());
+    printLcd(lcd);
+    if (vcd)
+        std::printf("VCD:         %llu value changes in %s\n", (unsigned long long)vcd->changes(), vcdPath);
+    for (const Mfrc522::Detection &detection : rfid.detections())
+    {
+        const uint8_t *uid = detection.card.uid;
+        std::printf("  %02X%02X%02X%02X: tap at %.1f ms, UID after %.2f ms, %llu SCK edges, %llu register accesses\n",
+                    uid[0], uid[1], uid[2], uid[3],
+                    cyclesToUs(detection.enterCycle) / 1000.0,
+                    cyclesToUs(detection.uidCycle - detection.enterCycle) / 1000.0,
+                    (unsigned long long)detection.sckEdges, (unsigned long long)detection.transactions);
+    }
+    bool pwmOk = !pwmReport || pwm.report(stdout);
+    if (scenarioPath)
+        scenario.report(stdout);
+    bool budgetOk = true;
+    if (ops)
+    {
+        ops->report(stdout);
+        budgetOk = !budgetsPath || ops->checkBudgets(stdout);
+    }
+    return pwmOk && budgetOk ? 0 : 1;
+}
@@ -0,0 +1,483 @@
+#include "Hc595.h"
+#include "Hd44780.h"
+#include "Keypad.h"
+#include "Mfrc522.h"
+#include "Pic18.h"
+#include "PwmCapture.h"
+#include "Scenario.h"
+#include "TController.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <poll.h>
+#include <random>
+#include <sstream>
+#include <string>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+/* =======================================
+ *        SOAK RUNNER (p2a_soak)
+ * ======================================= */
+/*
+ * Runs many randomised sessions of the firmware across all cores and merges
+ * what they measured. A session is a Scenario script drawn from a seed:
+ * card taps (known users and strangers), keypad light edits, the odd 3 s '#'
+ * reset, and PC menu traffic (who, configs, memory, time set, ESC, auto-baud
+ * with the odd stray key before the 'U's). The PC stays at 9600 baud.
+ *
+ * The firmware keeps its state in file-scope statics, so each session runs
+ * in its own forked process. The pool keeps one process per core busy: a
+ * core that finishes a session takes the next one, and results come back
+ * over a pipe. Idle main loop passes are fast-forwarded (see Pic18.h).
+ *
+ * Per session it checks:
+ * - Stuck controller: CNTR_IsIdle() FALSE for longer than kStuckMs
+ * - Crashes (the process dies on a signal or exits non-zero)
+ * - EEPROM writes (wear), UART framing errors, LCD protocol violations,
+ *   a stored baud divisor other than 9600's (auto-baud kept a wrong measure),
+ *   LED PWM duty/jitter (PwmCapture), longest main loop pass
+ * and merges the stimulus-to-output latencies of every session.
+ */
+
+void firmware_main(void);
+void RSI_High(void);
+
+using namespace sim;
+
+namespace
+{
+    constexpr uint64_t kStuckMs = 10000; // Longest legitimate command: the 3 s reset hold plus its report
+    constexpr uint64_t kEndQuietMs = 3000;
+    constexpr uint16_t kLATE = kLATA + PortE;
+    constexpr uint8_t kLoopMarker = 0x04; // LATE2
+
+    const char *const kKnownCards[] = {"33A13814", "E3A20E2A", "88056700"};
+    const char *const kUnknownCard = "0BADCAFE";
+    const char kIntensityKeys[] = "0123456789*";
+    const char kStrayKeys[] = "12345A"; // Typed before the auto-baud 'U', never measure a rate
+    constexpr uint32_t kHostBaud = 9600;
+    constexpr unsigned kDivisor9600 = 0x0340; // BRG16 + BRGH at 32 MHz
+
+    struct Options
+    {
+        unsigned runs = 0; // 0 = 4 per core
+        unsigned jobs = 0; // 0 = one per core
+        double seconds = 60.0;
+        unsigned seed = 1;
+    };
+
+    struct RunResult
+    {
+        unsigned run = 0;
+        unsigned seed = 0;
+        bool finished = false;
+        int status = 0;
+        uint64_t eepromWrites = 0;
+        unsigned baudDivisor = 0;
+        unsigned hottestAddress = 0;
+        uint64_t hottestWrites = 0;
+        uint64_t uartBytes = 0;
+        uint64_t framingErrors = 0;
+        uint64_t lcdViolations = 0;
+        uint64_t loopMax = 0;
+        bool pwmOk = true;
+        uint64_t stuck = 0;
+        uint64_t stuckAt = 0;
+        Scenario::LatencyTable latencies;
+    };
+
+    void usage(const char *program)
+    {
+        std::fprintf(stderr,
+                     "usage: %s [--runs N] [--jobs J] [--seconds S] [--seed X]\n"
+                     "  --runs     sessions to simulate (default 4 per core)\n"
+                     "  --jobs     sessions running at once (default one per core)\n"
+                     "  --seconds  simulated length of each session (default 60)\n"
+                     "  --seed     seed of the first session, the others follow (default 1)\n",
+                     program);
+        std::exit(1);
+    }
+
+    /* =======================================
+     *            SESSION (CHILD)
+     * ======================================= */
+
+    std::string randomSession(std::mt19937 &rng, double seconds)
+    {
+        std::ostringstream script;
+        auto below = [&rng](unsigned n)
+        { return (unsigned)(rng() % n); };
+        std::exponential_distribution<double> pause(1.0 / 2500.0);
+
+        script << "eeprom FC 03 40\n"; // 9600 baud
+        for (int user = 0; user < 3; user++)
+        {
+            script << "config " << user;
+            for (int led = 0; led < 6; led++)
+                script << " " << below(11);
+            script << "\n";
+        }
+
+        uint64_t end = (uint64_t)(seconds * 1000) - kEndQuietMs;
+        for (uint64_t ms = 500 + below(1000); ms < end; ms += 1500 + (uint64_t)pause(rng))
+        {
+            unsigned dice = below(100);
+            if (dice < 35)
+            {
+                script << ms << " card " << (below(10) ? kKnownCards[below(3)] : kUnknownCard) << "\n";
+            }
+            else if (dice < 65)
+            {
+                script << ms << " key " << below(6) << "\n";
+                script << ms + 200 + below(300) << " key " << kIntensityKeys[below(sizeof(kIntensityKeys) - 1)] << "\n";
+            }
+            else if (dice < 67)
+            {
+                script << ms << " key # 3500\n"; // Factory reset
+                ms += 3000;
+            }
+            else
+            {
+                switch (below(6))
+                {
+                case 0:
+                    script << ms << " serial 1\n";
+                    break;
+                case 1:
+                    script << ms << " serial 2\n";
+                    ms += 2000;
+                    break;
+                case 2:
+                    script << ms << " serial 5\n";
+                    ms += 1500;
+                    break;
+                case 3:
+                    script << ms << " time " << below(2) << below(10) << ":" << below(6) << below(10) << "\n";
+                    break;
+                case 4:
+                    // Auto-baud at the rate already in use, 'U' typed until the
+                    // menu comes back (one to measure, one to confirm)
+                    script << ms << " serial 4\n";
+                    script << ms + 300 << " serial A\n";
+                    if (below(2))
+                        script << ms + 850 << " serial " << kStrayKeys[below(sizeof(kStrayKeys) - 1)] << "\n";
+                    for (unsigned u = 0; u < 3; u++)
+                        script << ms + 900 + 50 * u << " serial U\n";
+                    ms += 1500;
+                    break;
+                default:
+                    script << ms << " serial \\e\n";
+                    break;
+                }
+            }
+        }
+        return script.str();
+    }
+
+    void runSession(unsigned run, unsigned seed, double seconds, FILE *out)
+    {
+        Pic18 &mcu = Pic18::instance();
+        Mfrc522 rfid(mcu);
+        Hd44780 lcd(mcu);
+        KeypadMatrix keypad(mcu);
+#ifdef SIM_HC595
+        Hc595Chain chain(mcu, SIM_HC595); // Before the capture: it latches first
+#endif
+        PwmCapture pwm(mcu);
+        Scenario scenario(mcu, rfid, keypad, lcd);
+
+        std::mt19937 rng(seed);
+        std::istringstream script(randomSession(rng, seconds));
+        std::string error;
+        if (!scenario.parse(script, "session " + std::to_string(seed), error))
+        {
+            std::fprintf(stderr, "%s\n", error.c_str());
+            std::exit(2);
+        }
+        scenario.schedule(1);
+
+        // Stuck controller watchdog, checked after every tick
+        uint64_t stuckCycles = msToCycles(kStuckMs);
+        uint64_t lastIdle = 0;
+        uint64_t stuck = 0;
+        uint64_t stuckAt = 0;
+        mcu.onInterruptReturn([&]
+                              {
+            if (CNTR_IsIdle())
+            {
+                lastIdle = mcu.cycle();
+            }
+            else if (mcu.cycle() - lastIdle > stuckCycles)
+            {
+                if (!stuck++)
+                    stuckAt = lastIdle;
+                lastIdle = mcu.cycle(); // One report per stuck period
+            } });
+
+        uint64_t loopLast = 0;
+        uint64_t loopSkipped = 0;
+        uint64_t loopMax = 0;
+        uint8_t loopMarker = 0;
+        mcu.onAccess([&](const SfrAccess &access)
+                     {
+            if (!access.write || access.inIsr || access.address != kLATE ||
+                (access.value & kLoopMarker) == loopMarker)
+                return;
+            loopMarker = access.value & kLoopMarker;
+            if (loopLast)
+                loopMax = std::max(loopMax, access.cycle - loopLast - (mcu.fastForwardCycles() - loopSkipped));
+            loopLast = access.cycle;
+            loopSkipped = mcu.fastForwardCycles(); });
+
+        mcu.setHostBaud(kHostBaud);
+        mcu.enableFastForward(kLATE, kLoopMarker);
+        mcu.setInterruptHandler(RSI_High);
+        mcu.run(firmware_main, msToCycles((uint64_t)(seconds * 1000)));
+
+        unsigned hottest = 0;
+        uint64_t framing = 0;
+        for (unsigned address = 0; address < 256; address++)
+        {
+            if (mcu.eepromWrites(address) > mcu.eepromWrites(hottest))
+                hottest = address;
+        }
+        for (const UartByte &byte : mcu.txLog())
+            framing += !byte.framingOk;
+        FILE *devnull = std::fopen("/dev/null", "w");
+        bool pwmOk = pwm.report(devnull);
+        std::fclose(devnull);
+
+        std::fprintf(out, "run %u %u\n", run, seed);
+        std::fprintf(out, "eeprom %llu %u %u\n", (unsigned long long)mcu.eepromWrites(), hottest,
+                     mcu.eepromWrites(hottest));
+        std::fprintf(out, "uart %zu %llu\n", mcu.txLog().size(), (unsigned long long)framing);
+        std::fprintf(out, "baud %u\n", (mcu.eeprom(0xFC) << 8) | mcu.eeprom(0xFD));
+        std::fprintf(out, "lcd %llu\n", (unsigned long long)(lcd.writesWhileBusy() + lcd.shortPulses()));
+        std::fprintf(out, "loop %llu\n", (unsigned long long)loopMax);
+        std::fprintf(out, "pwm %d\n", pwmOk ? 1 : 0);
+        std::fprintf(out, "stuck %llu %llu\n", (unsigned long long)stuck, (unsigned long long)stuckAt);
+        Scenario::LatencyTable latencies = scenario.latencies();
+        for (int kind = 0; kind < Scenario::kNumKinds; kind++)
+        {
+            for (int channel = 0; channel < Scenario::kNumChannels; channel++)
+            {
+                std::fprintf(out, "lat %d %d %llu", kind, channel,
+                             (unsigned long long)latencies.missed[kind][channel]);
+                for (uint64_t cycles : latencies.samples[kind][channel])
+                    std::fprintf(out, " %llu", (unsigned long long)cycles);
+                std::fprintf(out, "\n");
+            }
+        }
+        std::fprintf(out, "end\n");
+    }
+
+    /* =======================================
+     *             POOL (PARENT)
+     * ======================================= */
+
+    void parseResult(const std::string &text, RunResult &result)
+    {
+        std::istringstream in(text);
+        std::string line;
+        while (std::getline(in, line))
+        {
+            std::istringstream fields(line);
+            std::string tag;
+            fields >> tag;
+            if (tag == "eeprom")
+                fields >> result.eepromWrites >> result.hottestAddress >> result.hottestWrites;
+            else if (tag == "uart")
+                fields >> result.uartBytes >> result.framingErrors;
+            else if (tag == "baud")
+                fields >> result.baudDivisor;
+            else if (tag == "lcd")
+                fields >> result.lcdViolations;
+            else if (tag == "loop")
+                fields >> result.loopMax;
+            else if (tag == "pwm")
+                fields >> result.pwmOk;
+            else if (tag == "stuck")
+                fields >> result.stuck >> result.stuckAt;
+            else if (tag == "lat")
+            {
+                int kind, channel;
+                uint64_t cycles;
+                fields >> kind >> channel >> result.latencies.missed[kind][channel];
+                while (fields >> cycles)
+                    result.latencies.samples[kind][channel].push_back(cycles);
+            }
+            else if (tag == "end")
+                result.finished = true;
+        }
+    }
+
+    struct Worker
+    {
+        pid_t pid;
+        int fd;
+        RunResult result;
+        std::string output;
+    };
+
+    bool startWorker(const Options &options, unsigned run, Worker &worker)
+    {
+        int pipes[2];
+        if (pipe(pipes) != 0)
+            return false;
+        std::fflush(stdout);
+        pid_t pid = fork();
+        if (pid < 0)
+            return false;
+        if (pid == 0)
+        {
+            close(pipes[0]);
+            FILE *out = fdopen(pipes[1], "w");
+            runSession(run, options.seed + run, options.seconds, out);
+            std::fclose(out);
+            _exit(0);
+        }
+        close(pipes[1]);
+        worker.pid = pid;
+        worker.fd = pipes[0];
+        worker.result.run = run;
+        worker.result.seed = options.seed + run;
+        return true;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    Options options;
+    for (int i = 1; i < argc; i++)
+    {
+        if (!std::strcmp(argv[i], "--runs") && i + 1 < argc)
+            options.runs = std::atoi(argv[++i]);
+        else if (!std::strcmp(argv[i], "--jobs") && i + 1 < argc)
+            options.jobs = std::atoi(argv[++i]);
+        else if (!std::strcmp(argv[i], "--seconds") && i + 1 < argc)
+            options.seconds = std::atof(argv[++i]);
+        else if (!std::strcmp(argv[i], "--seed") && i + 1 < argc)
+            options.seed = std::atoi(argv[++i]);
+        else
+            usage(argv[0]);
+    }
+    if (options.seconds * 1000 < 2 * kEndQuietMs)
+        usage(argv[0]);
+    if (!options.jobs)
+        options.jobs = std::max(1L, sysconf(_SC_NPROCESSORS_ONLN));
+    if (!options.runs)
+        options.runs = 4 * options.jobs;
+
+    auto started = std::chrono::steady_clock::now();
+    std::vector<Worker> workers;
+    std::vector<RunResult> results;
+    unsigned next = 0;
+    while (next < options.runs || !workers.empty())
+    {
+        while (next < options.runs && workers.size() < options.jobs)
+        {
+            Worker worker = {};
+            if (!startWorker(options, next, worker))
+            {
+                std::perror("p2a_soak");
+                return 1;
+            }
+            workers.push_back(worker);
+            next++;
+        }
+
+        std::vector<pollfd> fds;
+        for (const Worker &worker : workers)
+            fds.push_back({worker.fd, POLLIN, 0});
+        if (poll(fds.data(), fds.size(), -1) < 0)
+            continue;
+        for (size_t i = fds.size(); i-- > 0;)
+        {
+            if (!fds[i].revents)
+                continue;
+            Worker &worker = workers[i];
+            char buffer[4096];
+            ssize_t count = read(worker.fd, buffer, sizeof(buffer));
+            if (count > 0)
+            {
+                worker.output.append(buffer, count);
+                continue;
+            }
+            close(worker.fd);
+            waitpid(worker.pid, &worker.result.status, 0);
+            parseResult(worker.output, worker.result);
+            results.push_back(worker.result);
+            workers.erase(workers.begin() + i);
+        }
+    }
+    double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+
+    // ---------- Merge ----------
+    std::sort(results.begin(), results.end(), [](const RunResult &a, const RunResult &b)
+              { return a.run < b.run; });
+    Scenario::LatencyTable latencies;
+    uint64_t eepromWrites = 0, eepromMax = 0, uartBytes = 0, framing = 0, lcdViolations = 0, loopMax = 0;
+    const RunResult *hottest = nullptr;
+    const RunResult *slowestLoop = nullptr;
+    unsigned failures = 0;
+    for (const RunResult &result : results)
+    {
+        latencies.merge(result.latencies);
+        eepromWrites += result.eepromWrites;
+        eepromMax = std::max(eepromMax, result.eepromWrites);
+        uartBytes += result.uartBytes;
+        framing += result.framingErrors;
+        lcdViolations += result.lcdViolations;
+        if (!hottest || result.hottestWrites > hottest->hottestWrites)
+            hottest = &result;
+        if (!slowestLoop || result.loopMax > slowestLoop->loopMax)
+            slowestLoop = &result;
+        loopMax = std::max(loopMax, result.loopMax);
+
+        bool crashed = !result.finished || !WIFEXITED(result.status) || WEXITSTATUS(result.status) != 0;
+        bool wrongBaud = result.baudDivisor != kDivisor9600;
+        if (crashed || result.stuck || !result.pwmOk || result.framingErrors || result.lcdViolations || wrongBaud)
+        {
+            failures++;
+            std::printf("FAIL run %u (--seed %u --runs 1):", result.run, result.seed);
+            if (crashed)
+                std::printf(" crashed (%s %d)", WIFSIGNALED(result.status) ? "signal" : "exit",
+                            WIFSIGNALED(result.status) ? WTERMSIG(result.status) : WEXITSTATUS(result.status));
+            if (result.stuck)
+                std::printf(" controller busy for %llu s from %.3f s", (unsigned long long)kStuckMs / 1000,
+                            cyclesToUs(result.stuckAt) / 1e6);
+            if (!result.pwmOk)
+                std::printf(" PWM duty/jitter");
+            if (result.framingErrors)
+                std::printf(" %llu UART framing errors", (unsigned long long)result.framingErrors);
+            if (result.lcdViolations)
+                std::printf(" %llu LCD protocol violations", (unsigned long long)result.lcdViolations);
+            if (wrongBaud)
+                std::printf(" baud divisor %u stored", result.baudDivisor);
+            std::printf("\n");
+        }
+    }
+
+    double simulated = options.seconds * results.size();
+    std::printf("\nSoak:        %zu sessions x %.0f s = %.2f h simulated in %.1f s on %u processes (%.0fx real time)\n",
+                results.size(), options.seconds, simulated / 3600, wall, options.jobs, simulated / wall);
+    std::printf("Failures:    %u\n", failures);
+    if (hottest)
+    {
+        std::printf("EEPROM:      %llu writes, max %llu per session, hottest address 0x%02X: %llu writes in session %u\n",
+                    (unsigned long long)eepromWrites, (unsigned long long)eepromMax, hottest->hottestAddress,
+                    (unsigned long long)hottest->hottestWrites, hottest->run);
+        std::printf("UART:        %llu bytes, %llu framing errors\n", (unsigned long long)uartBytes,
+                    (unsigned long long)framing);
+        std::printf("LCD:         %llu protocol violations\n", (unsigned long long)lcdViolations);
+        std::printf("Main loop:   longest pass %.1f ms (session %u)\n", cyclesToUs(loopMax) / 1000.0, slowestLoop->run);
+    }
+    std::printf("\n");
+    latencies.print(stdout);
+    return failures ? 1 : 0;
+}
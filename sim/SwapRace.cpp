@@ -0,0 +1,157 @@
+#include "Pic18.h"
+
+#include <csignal>
+#include <cstdio>
+#include <ucontext.h>
+
+/* =======================================
+ *      SCHEDULE SWAP RACE (p2a_swap_race)
+ * ======================================= */
+/*
+ * Interleaves the Timer2 interrupt with LED_UpdateConfig rewriting the spare
+ * light schedule, at every instruction of the rewrite. The simulator only
+ * takes interrupts between SFR accesses and LED_UpdateConfig makes none, so
+ * the call is single-stepped instead (x86 trap flag, one SIGTRAP per
+ * instruction) and the interrupt is taken from the trap handler, on the
+ * TLight.c object the other binaries link, as the compiler optimised it.
+ *
+ * Each round:
+ * - all lights at level 10, then a pending schedule with all of them off
+ *   that LED_Motor has not taken yet
+ * - LED_UpdateConfig back to all 10, cut at its Nth instruction by enough
+ *   LED_Motor tics for any swap to happen and its fade to end
+ * - the software LEDs must then all be lit for the whole period or all dark:
+ *   a mix means LED_Motor took the spare schedule half rewritten
+ * - once LED_UpdateConfig returns, every light ends at level 10
+ *
+ * x86-64 Linux, pins backend only (the 595 backend shares the swap
+ * handshake). Exit status 1 on any failure.
+ */
+
+void LED_Init(void);
+void LED_Motor(void);
+void LED_UpdateConfig_fw(unsigned char *config); // LED_UpdateConfig as TLight.o defines it (Makefile hooks)
+extern const unsigned char LED_FADE_PERIODS;
+
+using namespace sim;
+
+namespace
+{
+    constexpr int kTicsPerPeriod = 10;   // TLight.c MAX_TICS, one LED_Motor call each
+    constexpr uint8_t kSwLedPins = 0x1E; // LED0-2, LED5 on RD1-RD4 (Board.h)
+    constexpr greg_t kTrapFlag = 0x100;  // EFLAGS.TF
+
+    volatile bool armed;
+    volatile long stepsLeft;
+    volatile bool cutTaken;
+    volatile bool mixed;
+
+    // Runs 'periods' whole periods and returns the tics each software LED pin
+    // was lit during the last one (bit n of PORTD = pins[n])
+    void runPeriods(int periods, int pins[8])
+    {
+        Pic18 &mcu = Pic18::instance();
+        for (int bit = 0; bit < 8; bit++)
+            pins[bit] = 0;
+        for (int tic = 0; tic < periods * kTicsPerPeriod; tic++)
+        {
+            LED_Motor();
+            if (tic < (periods - 1) * kTicsPerPeriod)
+                continue;
+            uint8_t lit = mcu.latch(PortD) & kSwLedPins;
+            for (int bit = 0; bit < 8; bit++)
+                pins[bit] += (lit >> bit) & 1;
+        }
+    }
+
+    // TRUE when every software LED shows the same level, whole period on or off
+    bool wholeSchedule(const int pins[8], bool on)
+    {
+        for (int bit = 0; bit < 8; bit++)
+        {
+            if (((kSwLedPins >> bit) & 1) && pins[bit] != (on ? kTicsPerPeriod : 0))
+                return false;
+        }
+        return true;
+    }
+
+    void interrupt()
+    {
+        // The swap lands on the next period start, then the fade runs out
+        int pins[8];
+        runPeriods(LED_FADE_PERIODS + 2, pins);
+        mixed = !wholeSchedule(pins, false) && !wholeSchedule(pins, true);
+    }
+
+    void onTrap(int signal, siginfo_t *info, void *context)
+    {
+        greg_t &flags = static_cast<ucontext_t *>(context)->uc_mcontext.gregs[REG_EFL];
+        if (!armed)
+        {
+            flags &= ~kTrapFlag;
+            return;
+        }
+        if (--stepsLeft == 0)
+        {
+            armed = false;
+            cutTaken = true;
+            interrupt();
+        }
+    }
+
+    void startStepping()
+    {
+        // The instruction after popf traps, and every one after it until
+        // onTrap clears the flag
+        asm volatile("pushfq\n\torq $0x100, (%%rsp)\n\tpopfq" ::: "memory", "cc");
+    }
+}
+
+int main(void)
+{
+    unsigned char on[6] = {10, 10, 10, 10, 10, 10};
+    unsigned char off[6] = {0, 0, 0, 0, 0, 0};
+    int failures = 0;
+    int rounds = 0;
+
+    struct sigaction action = {};
+    action.sa_sigaction = onTrap;
+    action.sa_flags = SA_SIGINFO;
+    sigaction(SIGTRAP, &action, nullptr);
+
+    for (long cut = 1;; cut++)
+    {
+        int pins[8];
+        Pic18::instance().reset();
+        LED_Init();
+        LED_UpdateConfig_fw(on);
+        runPeriods(LED_FADE_PERIODS + 2, pins);
+        LED_UpdateConfig_fw(off);
+
+        cutTaken = false;
+        mixed = false;
+        stepsLeft = cut;
+        armed = true;
+        startStepping();
+        LED_UpdateConfig_fw(on);
+        armed = false;
+        if (!cutTaken)
+            break; // Past the last instruction of the rewrite
+        rounds++;
+
+        runPeriods(LED_FADE_PERIODS + 2, pins);
+        if (mixed)
+        {
+            std::printf("cut at instruction %ld: LED_Motor took a half rewritten schedule\n", cut);
+            failures++;
+        }
+        else if (!wholeSchedule(pins, true))
+        {
+            std::printf("cut at instruction %ld: lights did not end at the new configuration\n", cut);
+            failures++;
+        }
+    }
+
+    std::printf("Swap race:   %d cut points, %d failures\n", rounds, failures);
+    return failures || rounds == 0 ? 1 : 0;
+}
@@ -0,0 +1,150 @@
+#include "VcdTrace.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace sim
+{
+    /* =======================================
+     *              CONSTANTS
+     * ======================================= */
+
+    struct Signal
+    {
+        const char *scope;
+        const char *name;
+        int port;
+        uint8_t pin;
+    };
+
+    const Signal kSignals[] = {
+        {"rfid", "CS", PortC, 0x01},
+        {"rfid", "SCK", PortC, 0x10},
+        {"rfid", "SI", PortC, 0x20},
+        {"rfid", "SO", PortC, 0x08},
+        {"rfid", "RST", PortD, 0x01},
+        {"lcd", "RS", PortD, 0x20},
+        {"lcd", "RW", PortD, 0x40},
+        {"lcd", "E", PortD, 0x80},
+        {"lcd", "D4", PortB, 0x01},
+        {"lcd", "D5", PortB, 0x02},
+        {"lcd", "D6", PortB, 0x04},
+        {"lcd", "D7", PortB, 0x08},
+#ifdef SIM_HC595
+        {"chain", "SER", PortD, 0x02},
+        {"chain", "SRCLK", PortD, 0x04},
+        {"chain", "RCLK", PortD, 0x08},
+#else
+        {"leds", "LED0", PortD, 0x02},
+        {"leds", "LED1", PortD, 0x04},
+        {"leds", "LED2", PortD, 0x08},
+        {"leds", "LED3", PortC, 0x04},
+        {"leds", "LED4", PortC, 0x02},
+        {"leds", "LED5", PortD, 0x10},
+#endif
+        {"main", "LATE2", PortE, 0x04},
+    };
+    constexpr int kNumSignals = sizeof(kSignals) / sizeof(kSignals[0]);
+    constexpr uint64_t kNsPerCycle = 1000000000 / kFcy;
+
+    char identifier(int signal)
+    {
+        return (char)('!' + signal);
+    }
+
+    /* =======================================
+     *                TRACE
+     * ======================================= */
+
+    VcdTrace::VcdTrace(Pic18 &mcu, FILE *out, uint64_t fromCycle, uint64_t toCycle)
+        : mcu_(mcu), out_(out), fromCycle_(fromCycle), toCycle_(toCycle),
+          started_(false), finished_(false), values_(0), lastTime_(UINT64_MAX), changes_(0)
+    {
+        std::fprintf(out_, "$version p2a_sim $end\n$timescale 1 ns $end\n$scope module p2a $end\n");
+        const char *scope = nullptr;
+        for (int signal = 0; signal < kNumSignals; signal++)
+        {
+            if (!scope || std::strcmp(scope, kSignals[signal].scope))
+            {
+                if (scope)
+                    std::fprintf(out_, "$upscope $end\n");
+                scope = kSignals[signal].scope;
+                std::fprintf(out_, "$scope module %s $end\n", scope);
+            }
+            std::fprintf(out_, "$var wire 1 %c %s $end\n", identifier(signal), kSignals[signal].name);
+        }
+        std::fprintf(out_, "$upscope $end\n$upscope $end\n$enddefinitions $end\n");
+
+        mcu.attach(this);
+        mcu.at(fromCycle, [this]
+               {
+            started_ = true;
+            values_ = levels();
+            dump(values_, true); });
+    }
+
+    void VcdTrace::finish()
+    {
+        if (finished_)
+            return;
+        finished_ = true;
+        uint64_t end = toCycle_ ? std::min(toCycle_, mcu_.cycle()) : mcu_.cycle();
+        if (started_ && end * kNsPerCycle != lastTime_)
+            std::fprintf(out_, "#%llu\n", (unsigned long long)(end * kNsPerCycle));
+        std::fflush(out_);
+    }
+
+    bool VcdTrace::dumping() const
+    {
+        return started_ && !finished_ && (toCycle_ == 0 || mcu_.cycle() < toCycle_);
+    }
+
+    uint32_t VcdTrace::levels()
+    {
+        uint8_t pins[kNumPorts];
+        for (int port = 0; port < kNumPorts; port++)
+            pins[port] = mcu_.pins(port);
+
+        uint32_t values = 0;
+        for (int signal = 0; signal < kNumSignals; signal++)
+        {
+            if (pins[kSignals[signal].port] & kSignals[signal].pin)
+                values |= 1u << signal;
+        }
+        return values;
+    }
+
+    void VcdTrace::dump(uint32_t values, bool all)
+    {
+        uint64_t time = mcu_.cycle() * kNsPerCycle;
+        if (time != lastTime_)
+        {
+            std::fprintf(out_, "#%llu\n", (unsigned long long)time);
+            lastTime_ = time;
+        }
+        if (all)
+            std::fprintf(out_, "$dumpvars\n");
+        for (int signal = 0; signal < kNumSignals; signal++)
+        {
+            if (all || ((values ^ values_) & (1u << signal)))
+            {
+                std::fprintf(out_, "%c%c\n", (values & (1u << signal)) ? '1' : '0', identifier(signal));
+                changes_++;
+            }
+        }
+        if (all)
+            std::fprintf(out_, "$end\n");
+    }
+
+    void VcdTrace::onPinsChanged(Pic18 &mcu, int port)
+    {
+        if (!dumping())
+            return;
+        uint32_t values = levels();
+        if (values != values_)
+        {
+            dump(values, false);
+            values_ = values;
+        }
+    }
+}
@@ -0,0 +1,58 @@
+#ifndef SIM_VCDTRACE_H
+#define SIM_VCDTRACE_H
+
+#include "Pic18.h"
+
+#include <cstdint>
+#include <cstdio>
+
+/* =======================================
+ *        VCD WAVEFORM EXPORT
+ * ======================================= */
+/*
+ * Dumps the board signals as a Value Change Dump (IEEE 1364) for GTKWave:
+ * - rfid: CS RC0, SCK RC4, SI RC5, SO RC3, RST RD0
+ * - lcd: RS RD5, RW RD6, E RD7, D4-D7 RB0-RB3 (as seen on the pins, so
+ *   busy-flag reads show what the HD44780 drives)
+ * - leds: LED0-LED5 (RD1, RD2, RD3, RC2 CCP1, RC1 CCP2, RD4), or with
+ *   SIM_HC595 chain: SER RD1, SRCLK RD2, RCLK RD3 of the 74HC595 chain
+ * - main: LATE2, toggled once per main loop pass
+ *
+ * Pin levels are taken after every PORT/LAT/TRIS write, once the other
+ * devices have reacted to it: construct the trace after them. Timestamps are
+ * in ns (one instruction cycle = 125 ns).
+ */
+
+namespace sim
+{
+    class VcdTrace : public Peripheral
+    {
+    public:
+        // Dumps from 'fromCycle' to 'toCycle' (0 = until finish())
+        VcdTrace(Pic18 &mcu, FILE *out, uint64_t fromCycle, uint64_t toCycle);
+
+        // Closes the dump at the current cycle
+        void finish();
+        uint64_t changes() const { return changes_; }
+
+        // ---------- Peripheral ----------
+        void onPinsChanged(Pic18 &mcu, int port) override;
+
+    private:
+        uint32_t levels();
+        void dump(uint32_t values, bool all);
+        bool dumping() const;
+
+        Pic18 &mcu_;
+        FILE *out_;
+        uint64_t fromCycle_;
+        uint64_t toCycle_;
+        bool started_;
+        bool finished_;
+        uint32_t values_; // Bit per signal
+        uint64_t lastTime_;
+        uint64_t changes_;
+    };
+}
+
+#endif
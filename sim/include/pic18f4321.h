@@ -0,0 +1,488 @@
+#ifndef SIM_PIC18F4321_H
+#define SIM_PIC18F4321_H
+
+/* =======================================
+ *     PIC18F4321 SFR MAP (HOST BUILD)
+ * ======================================= */
+/*
+ * Replaces the XC8 device header when the firmware is compiled for the host
+ * simulator. Every register and bit field is a proxy object, so each access
+ * from the unchanged TAD modules is routed through sim::Pic18, which advances
+ * the virtual clock and applies the peripheral side effects.
+ *
+ * Only the registers used by the firmware (plus their neighbours) are mapped.
+ * Addresses match the PIC18F4321 datasheet.
+ */
+
+#include "sim_sfr.h"
+
+inline sim::Sfr8<0xF80> PORTA;
+struct PORTAbits_t
+{
+    sim::SfrField<0xF80, 0, 1> RA0;
+    sim::SfrField<0xF80, 1, 1> RA1;
+    sim::SfrField<0xF80, 2, 1> RA2;
+    sim::SfrField<0xF80, 3, 1> RA3;
+    sim::SfrField<0xF80, 4, 1> RA4;
+    sim::SfrField<0xF80, 5, 1> RA5;
+    sim::SfrField<0xF80, 6, 1> RA6;
+    sim::SfrField<0xF80, 7, 1> RA7;
+};
+inline PORTAbits_t PORTAbits;
+
+inline sim::Sfr8<0xF81> PORTB;
+struct PORTBbits_t
+{
+    sim::SfrField<0xF81, 0, 1> RB0;
+    sim::SfrField<0xF81, 1, 1> RB1;
+    sim::SfrField<0xF81, 2, 1> RB2;
+    sim::SfrField<0xF81, 3, 1> RB3;
+    sim::SfrField<0xF81, 4, 1> RB4;
+    sim::SfrField<0xF81, 5, 1> RB5;
+    sim::SfrField<0xF81, 6, 1> RB6;
+    sim::SfrField<0xF81, 7, 1> RB7;
+};
+inline PORTBbits_t PORTBbits;
+
+inline sim::Sfr8<0xF82> PORTC;
+struct PORTCbits_t
+{
+    sim::SfrField<0xF82, 0, 1> RC0;
+    sim::SfrField<0xF82, 1, 1> RC1;
+    sim::SfrField<0xF82, 2, 1> RC2;
+    sim::SfrField<0xF82, 3, 1> RC3;
+    sim::SfrField<0xF82, 4, 1> RC4;
+    sim::SfrField<0xF82, 5, 1> RC5;
+    sim::SfrField<0xF82, 6, 1> RC6;
+    sim::SfrField<0xF82, 7, 1> RC7;
+};
+inline PORTCbits_t PORTCbits;
+
+inline sim::Sfr8<0xF83> PORTD;
+struct PORTDbits_t
+{
+    sim::SfrField<0xF83, 0, 1> RD0;
+    sim::SfrField<0xF83, 1, 1> RD1;
+    sim::SfrField<0xF83, 2, 1> RD2;
+    sim::SfrField<0xF83, 3, 1> RD3;
+    sim::SfrField<0xF83, 4, 1> RD4;
+    sim::SfrField<0xF83, 5, 1> RD5;
+    sim::SfrField<0xF83, 6, 1> RD6;
+    sim::SfrField<0xF83, 7, 1> RD7;
+};
+inline PORTDbits_t PORTDbits;
+
+inline sim::Sfr8<0xF84> PORTE;
+struct PORTEbits_t
+{
+    sim::SfrField<0xF84, 0, 1> RE0;
+    sim::SfrField<0xF84, 1, 1> RE1;
+    sim::SfrField<0xF84, 2, 1> RE2;
+    sim::SfrField<0xF84, 3, 1> RE3;
+};
+inline PORTEbits_t PORTEbits;
+
+inline sim::Sfr8<0xF89> LATA;
+struct LATAbits_t
+{
+    sim::SfrField<0xF89, 0, 1> LATA0;
+    sim::SfrField<0xF89, 1, 1> LATA1;
+    sim::SfrField<0xF89, 2, 1> LATA2;
+    sim::SfrField<0xF89, 3, 1> LATA3;
+    sim::SfrField<0xF89, 4, 1> LATA4;
+    sim::SfrField<0xF89, 5, 1> LATA5;
+    sim::SfrField<0xF89, 6, 1> LATA6;
+    sim::SfrField<0xF89, 7, 1> LATA7;
+};
+inline LATAbits_t LATAbits;
+
+inline sim::Sfr8<0xF8A> LATB;
+struct LATBbits_t
+{
+    sim::SfrField<0xF8A, 0, 1> LATB0;
+    sim::SfrField<0xF8A, 1, 1> LATB1;
+    sim::SfrField<0xF8A, 2, 1> LATB2;
+    sim::SfrField<0xF8A, 3, 1> LATB3;
+    sim::SfrField<0xF8A, 4, 1> LATB4;
+    sim::SfrField<0xF8A, 5, 1> LATB5;
+    sim::SfrField<0xF8A, 6, 1> LATB6;
+    sim::SfrField<0xF8A, 7, 1> LATB7;
+};
+inline LATBbits_t LATBbits;
+
+inline sim::Sfr8<0xF8B> LATC;
+struct LATCbits_t
+{
+    sim::SfrField<0xF8B, 0, 1> LATC0;
+    sim::SfrField<0xF8B, 1, 1> LATC1;
+    sim::SfrField<0xF8B, 2, 1> LATC2;
+    sim::SfrField<0xF8B, 3, 1> LATC3;
+    sim::SfrField<0xF8B, 4, 1> LATC4;
+    sim::SfrField<0xF8B, 5, 1> LATC5;
+    sim::SfrField<0xF8B, 6, 1> LATC6;
+    sim::SfrField<0xF8B, 7, 1> LATC7;
+};
+inline LATCbits_t LATCbits;
+
+inline sim::Sfr8<0xF8C> LATD;
+struct LATDbits_t
+{
+    sim::SfrField<0xF8C, 0, 1> LATD0;
+    sim::SfrField<0xF8C, 1, 1> LATD1;
+    sim::SfrField<0xF8C, 2, 1> LATD2;
+    sim::SfrField<0xF8C, 3, 1> LATD3;
+    sim::SfrField<0xF8C, 4, 1> LATD4;
+    sim::SfrField<0xF8C, 5, 1> LATD5;
+    sim::SfrField<0xF8C, 6, 1> LATD6;
+    sim::SfrField<0xF8C, 7, 1> LATD7;
+};
+inline LATDbits_t LATDbits;
+
+inline sim::Sfr8<0xF8D> LATE;
+struct LATEbits_t
+{
+    sim::SfrField<0xF8D, 0, 1> LATE0;
+    sim::SfrField<0xF8D, 1, 1> LATE1;
+    sim::SfrField<0xF8D, 2, 1> LATE2;
+};
+inline LATEbits_t LATEbits;
+
+inline sim::Sfr8<0xF92> TRISA;
+struct TRISAbits_t
+{
+    sim::SfrField<0xF92, 0, 1> TRISA0;
+    sim::SfrField<0xF92, 1, 1> TRISA1;
+    sim::SfrField<0xF92, 2, 1> TRISA2;
+    sim::SfrField<0xF92, 3, 1> TRISA3;
+    sim::SfrField<0xF92, 4, 1> TRISA4;
+    sim::SfrField<0xF92, 5, 1> TRISA5;
+    sim::SfrField<0xF92, 6, 1> TRISA6;
+    sim::SfrField<0xF92, 7, 1> TRISA7;
+};
+inline TRISAbits_t TRISAbits;
+
+inline sim::Sfr8<0xF93> TRISB;
+struct TRISBbits_t
+{
+    sim::SfrField<0xF93, 0, 1> TRISB0;
+    sim::SfrField<0xF93, 1, 1> TRISB1;
+    sim::SfrField<0xF93, 2, 1> TRISB2;
+    sim::SfrField<0xF93, 3, 1> TRISB3;
+    sim::SfrField<0xF93, 4, 1> TRISB4;
+    sim::SfrField<0xF93, 5, 1> TRISB5;
+    sim::SfrField<0xF93, 6, 1> TRISB6;
+    sim::SfrField<0xF93, 7, 1> TRISB7;
+};
+inline TRISBbits_t TRISBbits;
+
+inline sim::Sfr8<0xF94> TRISC;
+struct TRISCbits_t
+{
+    sim::SfrField<0xF94, 0, 1> TRISC0;
+    sim::SfrField<0xF94, 1, 1> TRISC1;
+    sim::SfrField<0xF94, 2, 1> TRISC2;
+    sim::SfrField<0xF94, 3, 1> TRISC3;
+    sim::SfrField<0xF94, 4, 1> TRISC4;
+    sim::SfrField<0xF94, 5, 1> TRISC5;
+    sim::SfrField<0xF94, 6, 1> TRISC6;
+    sim::SfrField<0xF94, 7, 1> TRISC7;
+};
+inline TRISCbits_t TRISCbits;
+
+inline sim::Sfr8<0xF95> TRISD;
+struct TRISDbits_t
+{
+    sim::SfrField<0xF95, 0, 1> TRISD0;
+    sim::SfrField<0xF95, 1, 1> TRISD1;
+    sim::SfrField<0xF95, 2, 1> TRISD2;
+    sim::SfrField<0xF95, 3, 1> TRISD3;
+    sim::SfrField<0xF95, 4, 1> TRISD4;
+    sim::SfrField<0xF95, 5, 1> TRISD5;
+    sim::SfrField<0xF95, 6, 1> TRISD6;
+    sim::SfrField<0xF95, 7, 1> TRISD7;
+};
+inline TRISDbits_t TRISDbits;
+
+inline sim::Sfr8<0xF96> TRISE;
+struct TRISEbits_t
+{
+    sim::SfrField<0xF96, 0, 1> TRISE0;
+    sim::SfrField<0xF96, 1, 1> TRISE1;
+    sim::SfrField<0xF96, 2, 1> TRISE2;
+};
+inline TRISEbits_t TRISEbits;
+
+inline sim::Sfr8<0xF9B> OSCTUNE;
+struct OSCTUNEbits_t
+{
+    sim::SfrField<0xF9B, 0, 5> TUN;
+    sim::SfrField<0xF9B, 6, 1> PLLEN;
+    sim::SfrField<0xF9B, 7, 1> INTSRC;
+};
+inline OSCTUNEbits_t OSCTUNEbits;
+
+inline sim::Sfr8<0xF9D> PIE1;
+struct PIE1bits_t
+{
+    sim::SfrField<0xF9D, 0, 1> TMR1IE;
+    sim::SfrField<0xF9D, 1, 1> TMR2IE;
+    sim::SfrField<0xF9D, 2, 1> CCP1IE;
+    sim::SfrField<0xF9D, 3, 1> SSPIE;
+    sim::SfrField<0xF9D, 4, 1> TXIE;
+    sim::SfrField<0xF9D, 4, 1> TX1IE;
+    sim::SfrField<0xF9D, 5, 1> RCIE;
+    sim::SfrField<0xF9D, 5, 1> RC1IE;
+    sim::SfrField<0xF9D, 6, 1> ADIE;
+    sim::SfrField<0xF9D, 7, 1> PSPIE;
+};
+inline PIE1bits_t PIE1bits;
+
+inline sim::Sfr8<0xF9E> PIR1;
+struct PIR1bits_t
+{
+    sim::SfrField<0xF9E, 0, 1> TMR1IF;
+    sim::SfrField<0xF9E, 1, 1> TMR2IF;
+    sim::SfrField<0xF9E, 2, 1> CCP1IF;
+    sim::SfrField<0xF9E, 3, 1> SSPIF;
+    sim::SfrField<0xF9E, 4, 1> TXIF;
+    sim::SfrField<0xF9E, 4, 1> TX1IF;
+    sim::SfrField<0xF9E, 5, 1> RCIF;
+    sim::SfrField<0xF9E, 5, 1> RC1IF;
+    sim::SfrField<0xF9E, 6, 1> ADIF;
+    sim::SfrField<0xF9E, 7, 1> PSPIF;
+};
+inline PIR1bits_t PIR1bits;
+
+inline sim::Sfr8<0xF9F> IPR1;
+struct IPR1bits_t
+{
+    sim::SfrField<0xF9F, 0, 1> TMR1IP;
+    sim::SfrField<0xF9F, 1, 1> TMR2IP;
+    sim::SfrField<0xF9F, 2, 1> CCP1IP;
+    sim::SfrField<0xF9F, 3, 1> SSPIP;
+    sim::SfrField<0xF9F, 4, 1> TXIP;
+    sim::SfrField<0xF9F, 5, 1> RCIP;
+    sim::SfrField<0xF9F, 6, 1> ADIP;
+    sim::SfrField<0xF9F, 7, 1> PSPIP;
+};
+inline IPR1bits_t IPR1bits;
+
+inline sim::Sfr8<0xFA0> PIE2;
+struct PIE2bits_t
+{
+    sim::SfrField<0xFA0, 0, 1> CCP2IE;
+    sim::SfrField<0xFA0, 1, 1> TMR3IE;
+    sim::SfrField<0xFA0, 2, 1> HLVDIE;
+    sim::SfrField<0xFA0, 3, 1> BCLIE;
+    sim::SfrField<0xFA0, 4, 1> EEIE;
+    sim::SfrField<0xFA0, 6, 1> CMIE;
+    sim::SfrField<0xFA0, 7, 1> OSCFIE;
+};
+inline PIE2bits_t PIE2bits;
+
+inline sim::Sfr8<0xFA1> PIR2;
+struct PIR2bits_t
+{
+    sim::SfrField<0xFA1, 0, 1> CCP2IF;
+    sim::SfrField<0xFA1, 1, 1> TMR3IF;
+    sim::SfrField<0xFA1, 2, 1> HLVDIF;
+    sim::SfrField<0xFA1, 3, 1> BCLIF;
+    sim::SfrField<0xFA1, 4, 1> EEIF;
+    sim::SfrField<0xFA1, 6, 1> CMIF;
+    sim::SfrField<0xFA1, 7, 1> OSCFIF;
+};
+inline PIR2bits_t PIR2bits;
+
+inline sim::Sfr8<0xFA6> EECON1;
+struct EECON1bits_t
+{
+    sim::SfrField<0xFA6, 0, 1> RD;
+    sim::SfrField<0xFA6, 1, 1> WR;
+    sim::SfrField<0xFA6, 2, 1> WREN;
+    sim::SfrField<0xFA6, 3, 1> WRERR;
+    sim::SfrField<0xFA6, 4, 1> FREE;
+    sim::SfrField<0xFA6, 6, 1> CFGS;
+    sim::SfrField<0xFA6, 7, 1> EEPGD;
+};
+inline EECON1bits_t EECON1bits;
+
+inline sim::Sfr8<0xFA7> EECON2;
+inline sim::Sfr8<0xFA8> EEDATA;
+inline sim::Sfr8<0xFA9> EEADR;
+inline sim::Sfr8<0xFAB> RCSTA;
+struct RCSTAbits_t
+{
+    sim::SfrField<0xFAB, 0, 1> RX9D;
+    sim::SfrField<0xFAB, 1, 1> OERR;
+    sim::SfrField<0xFAB, 2, 1> FERR;
+    sim::SfrField<0xFAB, 3, 1> ADDEN;
+    sim::SfrField<0xFAB, 4, 1> CREN;
+    sim::SfrField<0xFAB, 5, 1> SREN;
+    sim::SfrField<0xFAB, 6, 1> RX9;
+    sim::SfrField<0xFAB, 7, 1> SPEN;
+};
+inline RCSTAbits_t RCSTAbits;
+
+inline sim::Sfr8<0xFAC> TXSTA;
+struct TXSTAbits_t
+{
+    sim::SfrField<0xFAC, 0, 1> TX9D;
+    sim::SfrField<0xFAC, 1, 1> TRMT;
+    sim::SfrField<0xFAC, 2, 1> BRGH;
+    sim::SfrField<0xFAC, 3, 1> SENDB;
+    sim::SfrField<0xFAC, 4, 1> SYNC;
+    sim::SfrField<0xFAC, 5, 1> TXEN;
+    sim::SfrField<0xFAC, 6, 1> TX9;
+    sim::SfrField<0xFAC, 7, 1> CSRC;
+};
+inline TXSTAbits_t TXSTAbits;
+
+inline sim::Sfr8<0xFAD> TXREG;
+inline sim::Sfr8<0xFAE> RCREG;
+inline sim::Sfr8<0xFAF> SPBRG;
+inline sim::Sfr8<0xFB0> SPBRGH;
+inline sim::Sfr8<0xFB8> BAUDCON;
+struct BAUDCONbits_t
+{
+    sim::SfrField<0xFB8, 0, 1> ABDEN;
+    sim::SfrField<0xFB8, 1, 1> WUE;
+    sim::SfrField<0xFB8, 3, 1> BRG16;
+    sim::SfrField<0xFB8, 4, 1> TXCKP;
+    sim::SfrField<0xFB8, 5, 1> RXDTP;
+    sim::SfrField<0xFB8, 6, 1> RCIDL;
+    sim::SfrField<0xFB8, 7, 1> ABDOVF;
+};
+inline BAUDCONbits_t BAUDCONbits;
+
+inline sim::Sfr8<0xFBA> CCP2CON;
+struct CCP2CONbits_t
+{
+    sim::SfrField<0xFBA, 0, 4> CCP2M;
+    sim::SfrField<0xFBA, 4, 2> DC2B;
+};
+inline CCP2CONbits_t CCP2CONbits;
+
+inline sim::Sfr8<0xFBB> CCPR2L;
+inline sim::Sfr8<0xFBC> CCPR2H;
+inline sim::Sfr8<0xFBD> CCP1CON;
+struct CCP1CONbits_t
+{
+    sim::SfrField<0xFBD, 0, 4> CCP1M;
+    sim::SfrField<0xFBD, 4, 2> DC1B;
+    sim::SfrField<0xFBD, 6, 2> P1M;
+};
+inline CCP1CONbits_t CCP1CONbits;
+
+inline sim::Sfr8<0xFBE> CCPR1L;
+inline sim::Sfr8<0xFBF> CCPR1H;
+inline sim::Sfr8<0xFC1> ADCON1;
+struct ADCON1bits_t
+{
+    sim::SfrField<0xFC1, 0, 4> PCFG;
+    sim::SfrField<0xFC1, 4, 2> VCFG;
+};
+inline ADCON1bits_t ADCON1bits;
+
+inline sim::Sfr8<0xFCA> T2CON;
+struct T2CONbits_t
+{
+    sim::SfrField<0xFCA, 0, 2> T2CKPS;
+    sim::SfrField<0xFCA, 2, 1> TMR2ON;
+    sim::SfrField<0xFCA, 3, 4> T2OUTPS;
+};
+inline T2CONbits_t T2CONbits;
+
+inline sim::Sfr8<0xFCB> PR2;
+inline sim::Sfr8<0xFCC> TMR2;
+inline sim::Sfr8<0xFCD> T1CON;
+inline sim::Sfr8<0xFCE> TMR1L;
+inline sim::Sfr8<0xFCF> TMR1H;
+inline sim::Sfr8<0xFD0> RCON;
+struct RCONbits_t
+{
+    sim::SfrField<0xFD0, 0, 1> BOR;
+    sim::SfrField<0xFD0, 1, 1> POR;
+    sim::SfrField<0xFD0, 2, 1> PD;
+    sim::SfrField<0xFD0, 3, 1> TO;
+    sim::SfrField<0xFD0, 4, 1> RI;
+    sim::SfrField<0xFD0, 6, 1> SBOREN;
+    sim::SfrField<0xFD0, 7, 1> IPEN;
+};
+inline RCONbits_t RCONbits;
+
+inline sim::Sfr8<0xFD3> OSCCON;
+struct OSCCONbits_t
+{
+    sim::SfrField<0xFD3, 0, 2> SCS;
+    sim::SfrField<0xFD3, 2, 1> IOFS;
+    sim::SfrField<0xFD3, 3, 1> OSTS;
+    sim::SfrField<0xFD3, 4, 3> IRCF;
+    sim::SfrField<0xFD3, 7, 1> IDLEN;
+};
+inline OSCCONbits_t OSCCONbits;
+
+inline sim::Sfr8<0xFD5> T0CON;
+struct T0CONbits_t
+{
+    sim::SfrField<0xFD5, 0, 3> T0PS;
+    sim::SfrField<0xFD5, 3, 1> PSA;
+    sim::SfrField<0xFD5, 4, 1> T0SE;
+    sim::SfrField<0xFD5, 5, 1> T0CS;
+    sim::SfrField<0xFD5, 6, 1> T08BIT;
+    sim::SfrField<0xFD5, 7, 1> TMR0ON;
+};
+inline T0CONbits_t T0CONbits;
+
+inline sim::Sfr8<0xFD6> TMR0L;
+inline sim::Sfr8<0xFD7> TMR0H;
+inline sim::Sfr8<0xFF1> INTCON2;
+struct INTCON2bits_t
+{
+    sim::SfrField<0xFF1, 0, 1> RBIP;
+    sim::SfrField<0xFF1, 2, 1> TMR0IP;
+    sim::SfrField<0xFF1, 4, 1> INTEDG2;
+    sim::SfrField<0xFF1, 5, 1> INTEDG1;
+    sim::SfrField<0xFF1, 6, 1> INTEDG0;
+    sim::SfrField<0xFF1, 7, 1> RBPU;
+};
+inline INTCON2bits_t INTCON2bits;
+
+inline sim::Sfr8<0xFF2> INTCON;
+struct INTCONbits_t
+{
+    sim::SfrField<0xFF2, 0, 1> RBIF;
+    sim::SfrField<0xFF2, 1, 1> INT0IF;
+    sim::SfrField<0xFF2, 2, 1> TMR0IF;
+    sim::SfrField<0xFF2, 2, 1> T0IF;
+    sim::SfrField<0xFF2, 3, 1> RBIE;
+    sim::SfrField<0xFF2, 4, 1> INT0IE;
+    sim::SfrField<0xFF2, 5, 1> TMR0IE;
+    sim::SfrField<0xFF2, 5, 1> T0IE;
+    sim::SfrField<0xFF2, 6, 1> PEIE;
+    sim::SfrField<0xFF2, 6, 1> GIEL;
+    sim::SfrField<0xFF2, 7, 1> GIE;
+    sim::SfrField<0xFF2, 7, 1> GIEH;
+};
+inline INTCONbits_t INTCONbits;
+
+inline sim::Sfr8<0xFFC> STKPTR;
+struct STKPTRbits_t
+{
+    sim::SfrField<0xFFC, 0, 5> STKPTR;
+    sim::SfrField<0xFFC, 6, 1> STKUNF;
+    sim::SfrField<0xFFC, 7, 1> STKFUL;
+};
+inline STKPTRbits_t STKPTRbits;
+
+inline sim::Sfr8<0xFFD> TOSL;
+inline sim::Sfr8<0xFFE> TOSH;
+inline sim::Sfr8<0xFFF> TOSU;
+// 16-bit Timer0 access, written/read as a whole like XC8 does with TMR0
+inline sim::Sfr16<0xFD6> TMR0;
+
+// Stand-alone bit names used by the firmware
+inline sim::SfrField<0xFF2, 2, 1> TMR0IF;
+inline sim::SfrField<0xFF2, 5, 1> TMR0IE;
+inline sim::SfrField<0xFF2, 7, 1> GIE;
+
+#endif
@@ -0,0 +1,80 @@
+#ifndef SIM_SFR_H
+#define SIM_SFR_H
+
+#include <cstdint>
+
+/* =======================================
+ *        SFR PROXIES (HOST BUILD)
+ * ======================================= */
+/*
+ * An SFR or bit field is an empty object whose address and bit position are
+ * template parameters. Reading converts through sim::sfrRead, writing goes
+ * through sim::sfrWrite/sfrWriteField, so the simulator sees every access in
+ * program order and charges it to the virtual clock.
+ *
+ * A bit field write is a single access (like BSF/BCF), not read + write.
+ */
+
+namespace sim
+{
+    uint8_t sfrRead(uint16_t address);
+    void sfrWrite(uint16_t address, uint8_t value);
+    void sfrWriteField(uint16_t address, uint8_t mask, uint8_t value);
+    uint16_t sfrRead16(uint16_t address);
+    void sfrWrite16(uint16_t address, uint16_t value);
+    void interruptsDisable();
+    void interruptsEnable();
+
+    template <uint16_t Address>
+    struct Sfr8
+    {
+        operator unsigned char() const { return sfrRead(Address); }
+        Sfr8 &operator=(unsigned value)
+        {
+            sfrWrite(Address, (uint8_t)value);
+            return *this;
+        }
+        Sfr8 &operator=(const Sfr8 &other) { return *this = (unsigned)(unsigned char)other; }
+        Sfr8 &operator|=(unsigned value) { return *this = sfrRead(Address) | value; }
+        Sfr8 &operator&=(unsigned value) { return *this = sfrRead(Address) & value; }
+        Sfr8 &operator^=(unsigned value) { return *this = sfrRead(Address) ^ value; }
+        Sfr8 &operator+=(unsigned value) { return *this = sfrRead(Address) + value; }
+        Sfr8 &operator-=(unsigned value) { return *this = sfrRead(Address) - value; }
+        Sfr8 &operator++() { return *this += 1; }
+        Sfr8 &operator--() { return *this -= 1; }
+    };
+
+    template <uint16_t Address, unsigned Shift, unsigned Width>
+    struct SfrField
+    {
+        static constexpr uint8_t kMask = (uint8_t)(((1u << Width) - 1) << Shift);
+
+        operator unsigned char() const { return (sfrRead(Address) & kMask) >> Shift; }
+        SfrField &operator=(unsigned value)
+        {
+            sfrWriteField(Address, kMask, (uint8_t)(value << Shift));
+            return *this;
+        }
+        SfrField &operator=(const SfrField &other) { return *this = (unsigned)(unsigned char)other; }
+        SfrField &operator|=(unsigned value) { return *this = (unsigned char)*this | value; }
+        SfrField &operator&=(unsigned value) { return *this = (unsigned char)*this & value; }
+        SfrField &operator^=(unsigned value) { return *this = (unsigned char)*this ^ value; }
+        SfrField &operator+=(unsigned value) { return *this = (unsigned char)*this + value; }
+        SfrField &operator-=(unsigned value) { return *this = (unsigned char)*this - value; }
+    };
+
+    // Low byte at Address, high byte at Address + 1
+    template <uint16_t Address>
+    struct Sfr16
+    {
+        operator unsigned short() const { return sfrRead16(Address); }
+        Sfr16 &operator=(unsigned value)
+        {
+            sfrWrite16(Address, (uint16_t)value);
+            return *this;
+        }
+        Sfr16 &operator=(const Sfr16 &other) { return *this = (unsigned)(unsigned short)other; }
+    };
+}
+
+#endif
@@ -0,0 +1,19 @@
+#ifndef SIM_XC_H
+#define SIM_XC_H
+
+/* =======================================
+ *        XC8 INTRINSICS (HOST BUILD)
+ * ======================================= */
+/*
+ * Host stand-in for <xc.h>. __XC8 is deliberately left undefined, so main.c
+ * builds RSI_High as a plain function that the simulator calls on interrupts.
+ */
+
+#include "pic18f4321.h"
+
+#define di() sim::interruptsDisable()
+#define ei() sim::interruptsEnable()
+#define NOP() ((void)0)
+#define CLRWDT() ((void)0)
+
+#endif